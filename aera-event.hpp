@@ -55,6 +55,7 @@
 #define AERA_EVENT_HPP
 
 #include <vector>
+#include <chrono>
 #include <QPointF>
 #include <QString>
 #include "submodules/AERA/r_code/object.h"
@@ -70,7 +71,10 @@ public:
     time_(time),
     object_(object),
     itemInitialTopLeftPosition_(qQNaN(), qQNaN()),
-    itemTopLeftPosition_(qQNaN(), qQNaN())
+    itemTopLeftPosition_(qQNaN(), qQNaN()),
+    isSimulation_(false),
+    goalOrPred_(GOAL_OR_PRED_NONE),
+    isEssenceFact_(false)
   {}
 
   virtual AeraEvent::~AeraEvent() {}
@@ -109,6 +113,43 @@ public:
     return reduction->get_reference(reduction->code(input_set_index + 2).asIndex());
   }
 
+  typedef enum { GOAL_OR_PRED_NONE, GOAL_OR_PRED_GOAL, GOAL_OR_PRED_PRED } GoalOrPred;
+
+  /**
+   * Set frameStartTime_ and the attributes of the object_ below, so that stepping and item placement
+   * don't follow the object references each time. AeraVisualizerWindow::addEvents calls this once
+   * for each event after parsing.
+   * \param timeReference The time reference of the frames.
+   * \param samplingPeriod The sampling period, which is the duration of a frame.
+   * \param essencePropertyObject The "essence" property object, or NULL if not defined.
+   */
+  virtual void setDerivedAttributes(
+    core::Timestamp timeReference, std::chrono::microseconds samplingPeriod, r_code::Code* essencePropertyObject)
+  {
+    auto relativeTime = std::chrono::duration_cast<std::chrono::microseconds>(time_ - timeReference);
+    frameStartTime_ = time_ - (relativeTime % samplingPeriod);
+
+    if (!object_ || object_->references_size() < 1)
+      return;
+
+    // Imitate the Replicode is_sim operator.
+    auto goalOrPred = object_->get_reference(0);
+    if (goalOrPred->code(0).asOpcode() == r_exec::Opcodes::Goal)
+      isSimulation_ = ((r_exec::Goal*)goalOrPred)->is_simulation();
+    else if (goalOrPred->code(0).asOpcode() == r_exec::Opcodes::Pred)
+      isSimulation_ = ((r_exec::Pred*)goalOrPred)->is_simulation();
+
+    if (object_->code(0).asOpcode() == r_exec::Opcodes::Fact ||
+        object_->code(0).asOpcode() == r_exec::Opcodes::AntiFact) {
+      setTargetTimes(object_);
+
+      // An essence fact is (fact (mk.val obj essence ...) ...).
+      auto mkVal = object_->get_reference(0);
+      isEssenceFact_ = (essencePropertyObject && mkVal->references_size() >= 2 &&
+                        mkVal->get_reference(1) == essencePropertyObject);
+    }
+  }
+
   int eventType_;
   core::Timestamp time_;
   r_code::Code* object_;
@@ -117,7 +158,50 @@ public:
   // itemTopLeftPosition_ is used by "New" events to remember the screen position after undoing.
   QPointF itemTopLeftPosition_;
 
+  // The following are set by setDerivedAttributes.
+  // The start time of the frame which contains time_.
+  core::Timestamp frameStartTime_;
+  // True if object_ is a simulated goal or prediction.
+  bool isSimulation_;
+  // Whether object_ is a fact of a goal or prediction.
+  GoalOrPred goalOrPred_;
+  // If object_ is a fact of a goal or prediction, the after and before times of its target fact.
+  // Otherwise, the after and before times of the fact itself.
+  core::Timestamp targetAfter_;
+  core::Timestamp targetBefore_;
+  // True if object_ is a fact of an mk.val with the "essence" property.
+  bool isEssenceFact_;
+
 protected:
+  /**
+   * Set goalOrPred_, targetAfter_ and targetBefore_ from the fact.
+   * \param fact The (fact (goal_or_pred (fact ...))) or other fact. If NULL, do nothing.
+   */
+  void setTargetTimes(r_code::Code* fact)
+  {
+    if (!fact)
+      return;
+
+    auto goal = ((r_exec::_Fact*)fact)->get_goal();
+    if (goal) {
+      goalOrPred_ = GOAL_OR_PRED_GOAL;
+      targetAfter_ = goal->get_target()->get_after();
+      targetBefore_ = goal->get_target()->get_before();
+      return;
+    }
+
+    auto pred = ((r_exec::_Fact*)fact)->get_pred();
+    if (pred) {
+      goalOrPred_ = GOAL_OR_PRED_PRED;
+      targetAfter_ = pred->get_target()->get_after();
+      targetBefore_ = pred->get_target()->get_before();
+      return;
+    }
+
+    targetAfter_ = ((r_exec::_Fact*)fact)->get_after();
+    targetBefore_ = ((r_exec::_Fact*)fact)->get_before();
+  }
+
   void addOtherInput(r_code::Code* input) {
     if (input)
       otherInputs_.push_back(input);
@@ -150,17 +234,13 @@ public:
   (core::Timestamp time, r_code::Code* model, core::float32 evidenceCount, core::float32 successRate)
     : AeraEvent(EVENT_TYPE, time, model),
     evidenceCount_(evidenceCount),
-    successRate_(successRate),
-    oldEvidenceCount_(qQNaN()),
-    oldSuccessRate_(qQNaN())
+    successRate_(successRate)
   {}
 
   static const int EVENT_TYPE = 2;
 
   core::float32 evidenceCount_;
   core::float32 successRate_;
-  core::float32 oldEvidenceCount_;
-  core::float32 oldSuccessRate_;
 };
 
 class SetModelStrengthEvent : public AeraEvent {
@@ -168,14 +248,12 @@ public:
   SetModelStrengthEvent
   (core::Timestamp time, r_code::Code* model, core::float32 strength)
     : AeraEvent(EVENT_TYPE, time, model),
-    strength_(strength),
-    oldStrength_(qQNaN())
+    strength_(strength)
   {}
 
   static const int EVENT_TYPE = 3;
 
   core::float32 strength_;
-  core::float32 oldStrength_;
 };
 
 class PhaseOutModelEvent : public AeraEvent {
@@ -196,7 +274,6 @@ public:
   static const int EVENT_TYPE = 5;
 };
 
-// TODO: Record whether it was phased out before deletion so that this can be restored during unstep.
 class DeleteModelEvent : public AeraEvent {
 public:
   DeleteModelEvent(core::Timestamp time, r_code::Code* model)
@@ -640,6 +717,17 @@ public:
 
   r_code::Code* getInput() override { return input_; }
 
+  /**
+   * Set the derived attributes as usual, and use the strong_requirement_ for the target times
+   * since object_ is NULL.
+   */
+  void setDerivedAttributes(
+    core::Timestamp timeReference, std::chrono::microseconds samplingPeriod, r_code::Code* essencePropertyObject) override
+  {
+    AeraEvent::setDerivedAttributes(timeReference, samplingPeriod, essencePropertyObject);
+    setTargetTimes(strong_requirement_);
+  }
+
   static const int EVENT_TYPE = 25;
 
   r_code::Code* model_;
@@ -695,6 +783,17 @@ public:
 
   r_code::Code* getInput() override { return input_; }
 
+  /**
+   * Set the derived attributes as usual, and use the input_ for the target times since object_
+   * is NULL.
+   */
+  void setDerivedAttributes(
+    core::Timestamp timeReference, std::chrono::microseconds samplingPeriod, r_code::Code* essencePropertyObject) override
+  {
+    AeraEvent::setDerivedAttributes(timeReference, samplingPeriod, essencePropertyObject);
+    setTargetTimes(input_);
+  }
+
   static const int EVENT_TYPE = 27;
 
   r_code::Code* model_;
@@ -178,9 +178,12 @@ AeraVisualizerWindow::AeraVisualizerWindow(ReplicodeObjects& replicodeObjects)
   showRelativeTime_(true),
   playTime_(seconds(0)),
   playTimerId_(0),
+  prebuildTimerId_(0),
+  iPrebuildEvent_(0),
   isPlaying_(false),
   newAbaEventsStartIndex_(0),
-  itemBorderHighlightPen_(Qt::blue, 3)
+  itemBorderHighlightPen_(Qt::blue, 3),
+  trimmedRecordsEnd_(0)
 {
   createActions();
   createMenus();
@@ -225,6 +228,22 @@ AeraVisualizerWindow::AeraVisualizerWindow(ReplicodeObjects& replicodeObjects)
   setUnifiedTitleAndToolBarOnMac(true);
 }
 
+AeraVisualizerWindow::~AeraVisualizerWindow()
+{
+  // The scenes delete their own items. Delete the removed and recycled items which are not in a scene.
+  set<AeraGraphicsItem*> items;
+  for (auto record = undoJournal_.begin(); record != undoJournal_.end(); ++record) {
+    if (record->type_ == UndoRecord::ITEM_REMOVED)
+      items.insert(record->item_);
+  }
+  for (auto entry = recycledItems_.begin(); entry != recycledItems_.end(); ++entry)
+    items.insert(entry->second);
+
+  undoJournal_.clear();
+  recycledItems_.clear();
+  deleteDetachedItems(items);
+}
+
 bool AeraVisualizerWindow::addEvents(const string& runtimeOutputFilePath, QProgressDialog& progress)
 {
   // load mdl 37, MDLController(113)
@@ -349,13 +368,12 @@ bool AeraVisualizerWindow::addEvents(const string& runtimeOutputFilePath, QProgr
     if (regex_search(line, matches, loadModelRegex)) {
       auto model = replicodeObjects_.getObject(stoul(matches[1].str()));
       if (model) {
-        // Restore the initial count, success rate and strength.
+        // Record the initial count, success rate and strength.
         core::float32 strength = stof(matches[3].str());
         core::float32 evidenceCount = stol(matches[4].str());
         core::float32 successRate = stof(matches[5].str());
-        model->code(MDL_STRENGTH) = Atom::Float(strength);
-        model->code(MDL_CNT) = Atom::Float(evidenceCount);
-        model->code(MDL_SR) = Atom::Float(successRate);
+        // The startup values are before any event.
+        replicodeObjects_.getModelValueHistory().add(model, 0, strength, evidenceCount, successRate);
         startupEvents_.push_back(make_shared <NewModelEvent>(
           replicodeObjects_.getTimeReference(), model, strength, evidenceCount, successRate, stoll(matches[2].str())));
       }
@@ -389,21 +407,30 @@ bool AeraVisualizerWindow::addEvents(const string& runtimeOutputFilePath, QProgr
       core::float32 strength = stof(matches[2].str());
       core::float32 evidenceCount = stol(matches[3].str());
       core::float32 successRate = stof(matches[4].str());
-      if (model)
+      if (model) {
+        // The sequence number of events_[i] is i + 1.
+        replicodeObjects_.getModelValueHistory().add(model, events_.size() + 1, strength, evidenceCount, successRate);
         events_.push_back(make_shared<NewModelEvent>(
           timestamp, model, strength, evidenceCount, successRate, stoll(matches[2].str())));
+      }
     }
     else if (regex_search(lineAfterTimestamp, matches, setEvidenceCountAndSuccessRateRegex)) {
       auto model = replicodeObjects_.getObject(stoul(matches[1].str()));
-      if (model)
-        events_.push_back(make_shared<SetModelEvidenceCountAndSuccessRateEvent>(
-          timestamp, model, stol(matches[2].str()), stof(matches[3].str())));
+      if (model) {
+        auto setSuccessRateEvent = make_shared<SetModelEvidenceCountAndSuccessRateEvent>(
+          timestamp, model, stol(matches[2].str()), stof(matches[3].str()));
+        replicodeObjects_.getModelValueHistory().addEvidenceCountAndSuccessRate(
+          model, events_.size() + 1, setSuccessRateEvent->evidenceCount_, setSuccessRateEvent->successRate_);
+        events_.push_back(setSuccessRateEvent);
+      }
     }
     else if (regex_search(lineAfterTimestamp, matches, setStrengthRegex)) {
       auto model = replicodeObjects_.getObject(stoul(matches[1].str()));
-      if (model)
-        events_.push_back(make_shared<SetModelStrengthEvent>(
-          timestamp, model, stof(matches[2].str())));
+      if (model) {
+        core::float32 strength = stof(matches[2].str());
+        replicodeObjects_.getModelValueHistory().addStrength(model, events_.size() + 1, strength);
+        events_.push_back(make_shared<SetModelStrengthEvent>(timestamp, model, strength));
+      }
     }
     else if (regex_search(lineAfterTimestamp, matches, deleteOrPhaseInOrOutModelRegex)) {
       auto model = replicodeObjects_.getObject(stoul(matches[1].str()));
@@ -816,6 +843,14 @@ bool AeraVisualizerWindow::addEvents(const string& runtimeOutputFilePath, QProgr
   }
   pendingEvents.clear();
 
+  // Precompute the attributes which stepEvent and the scenes use for each event.
+  for (auto event = startupEvents_.begin(); event != startupEvents_.end(); ++event)
+    (*event)->setDerivedAttributes(
+      replicodeObjects_.getTimeReference(), replicodeObjects_.getSamplingPeriod(), essencePropertyObject_);
+  for (auto event = events_.begin(); event != events_.end(); ++event)
+    (*event)->setDerivedAttributes(
+      replicodeObjects_.getTimeReference(), replicodeObjects_.getSamplingPeriod(), essencePropertyObject_);
+
   return true;
 }
 
@@ -844,7 +879,7 @@ void AeraVisualizerWindow::addStartupItems()
     AeraEvent* event = startupEvents_[i].get();
     if (event->time_ > replicodeObjects_.getTimeReference())
       // Finished scanning the initial events.
-      return;
+      break;
 
     if (event->eventType_ == NewModelEvent::EVENT_TYPE)
       // TODO: Add arrows.
@@ -855,6 +890,9 @@ void AeraVisualizerWindow::addStartupItems()
       modelsScene_->addAeraGraphicsItem(
         new CompositeStateItem((NewCompositeStateEvent*)event, replicodeObjects_, modelsScene_));
   }
+
+  // Prepare the items for the first frames.
+  startPrebuild();
 }
 
 Timestamp AeraVisualizerWindow::getTimestamp(const smatch& matches, int index)
@@ -871,21 +909,13 @@ AeraGraphicsItem* AeraVisualizerWindow::getAeraGraphicsItem(Code* object, AeraVi
     // Initialize to default NULL.
     *scene = 0;
 
-  auto item = modelsScene_->getAeraGraphicsItem(object);
-  if (item) {
-    if (scene)
-      *scene = modelsScene_;
-    return item;
-  }
-
-  item = mainScene_->getAeraGraphicsItem(object);
-  if (item) {
-    if (scene)
-      *scene = mainScene_;
-    return item;
-  }
+  auto entry = itemRegistry_.find(object);
+  if (entry == itemRegistry_.end())
+    return NULL;
 
-  return NULL;
+  if (scene)
+    *scene = entry->second.scene_;
+  return entry->second.item_;
 }
 
 void AeraVisualizerWindow::zoomToAeraGraphicsItem(Code* object)
@@ -927,9 +957,8 @@ void AeraVisualizerWindow::centerOnAeraGraphicsItem(Code* object)
   }
 }
 
-void AeraVisualizerWindow::textItemHoverMoveEvent(const QTextDocument* document, QPointF position)
+void AeraVisualizerWindow::textItemHoverMoveEvent(const QString& url)
 {
-  auto url = document->documentLayout()->anchorAt(position);
   if (url == "") {
     // The mouse cursor exited the link.
     if (hoverHighlightItem_) {
@@ -1012,6 +1041,162 @@ Timestamp AeraVisualizerWindow::getINextStepEvent
   return event->time_;
 }
 
+AeraVisualizerScene* AeraVisualizerWindow::getSceneForEvent(const AeraEvent* event)
+{
+  if (event->eventType_ == NewModelEvent::EVENT_TYPE ||
+      event->eventType_ == NewCompositeStateEvent::EVENT_TYPE)
+    return modelsScene_;
+  else
+    return mainScene_;
+}
+
+AeraGraphicsItem* AeraVisualizerWindow::createItem(AeraEvent* event, AeraVisualizerScene* scene)
+{
+  switch (event->eventType_) {
+  case NewModelEvent::EVENT_TYPE:
+    return new ModelItem((NewModelEvent*)event, replicodeObjects_, scene);
+  case NewCompositeStateEvent::EVENT_TYPE:
+    return new CompositeStateItem((NewCompositeStateEvent*)event, replicodeObjects_, scene);
+  case NewReductionMarkerEvent::EVENT_TYPE:
+    return new ReductionMarkerItem((NewReductionMarkerEvent*)event, replicodeObjects_, scene);
+  case AutoFocusNewObjectEvent::EVENT_TYPE:
+    return new AutoFocusFactItem((AutoFocusNewObjectEvent*)event, replicodeObjects_, scene);
+  case ModelMkValPredictionReduction::EVENT_TYPE:
+    return new PredictionItem((ModelMkValPredictionReduction*)event, replicodeObjects_, scene);
+  case ModelImdlPredictionEvent::EVENT_TYPE:
+    return new ModelImdlPredictionItem((ModelImdlPredictionEvent*)event, replicodeObjects_, scene);
+  case ModelGoalReduction::EVENT_TYPE:
+    return new ModelGoalItem((ModelGoalReduction*)event, replicodeObjects_, scene);
+  case CompositeStateGoalReduction::EVENT_TYPE:
+    return new CompositeStateGoalItem((CompositeStateGoalReduction*)event, replicodeObjects_, scene);
+  case ModelSimulatedPredictionReduction::EVENT_TYPE:
+    return new ModelPredictionItem((ModelSimulatedPredictionReduction*)event, replicodeObjects_, scene);
+  case ModelSimulatedPredictionReductionFromGoalRequirement::EVENT_TYPE:
+    return new ModelPredictionFromRequirementItem(
+      (ModelSimulatedPredictionReductionFromGoalRequirement*)event, replicodeObjects_, scene);
+  case ModelPredictionFromRequirementDisabledEvent::EVENT_TYPE:
+    return new ModelPredictionFromRequirementDisabledItem(
+      (ModelPredictionFromRequirementDisabledEvent*)event, replicodeObjects_, scene);
+  case CompositeStateSimulatedPredictionReduction::EVENT_TYPE:
+    return new CompositeStatePredictionItem((CompositeStateSimulatedPredictionReduction*)event, replicodeObjects_, scene);
+  case PredictionResultEvent::EVENT_TYPE:
+    return new PredictionResultItem((PredictionResultEvent*)event, replicodeObjects_, scene);
+  case NewInstantiatedCompositeStateEvent::EVENT_TYPE:
+    return new InstantiatedCompositeStateItem((NewInstantiatedCompositeStateEvent*)event, replicodeObjects_, scene);
+  case NewPredictedInstantiatedCompositeStateEvent::EVENT_TYPE:
+    return new PredictedInstantiatedCompositeStateItem(
+      (NewPredictedInstantiatedCompositeStateEvent*)event, replicodeObjects_, scene);
+  case IoDeviceInjectEvent::EVENT_TYPE:
+  case IoDeviceEjectEvent::EVENT_TYPE:
+    return new IoDeviceInjectEjectItem(event, replicodeObjects_, scene);
+  case DriveInjectEvent::EVENT_TYPE:
+    return new DriveItem((DriveInjectEvent*)event, replicodeObjects_, scene);
+  case SimulationCommitEvent::EVENT_TYPE:
+    return new SimulationCommitItem((SimulationCommitEvent*)event, replicodeObjects_, scene);
+  case PromotedSimulatedPredictionEvent::EVENT_TYPE:
+    return new PromotedPredictionItem((PromotedSimulatedPredictionEvent*)event, replicodeObjects_, scene);
+  case PromotedSimulatedPredictionDefeatEvent::EVENT_TYPE:
+    return new PromotedPredictionDefeatedItem((PromotedSimulatedPredictionDefeatEvent*)event, replicodeObjects_, scene);
+  case AbaAddSentence::EVENT_TYPE:
+    return new AbaSentenceItem((AbaAddSentence*)event, replicodeObjects_, scene);
+  case NewInstantiatedModelEvent::EVENT_TYPE:
+    return new ImdlItem((NewInstantiatedModelEvent*)event, replicodeObjects_, scene);
+  default:
+    return NULL;
+  }
+}
+
+AeraGraphicsItem* AeraVisualizerWindow::newOrRecycledItem(AeraEvent* event, AeraVisualizerScene* scene)
+{
+  auto recycled = recycledItems_.find(event);
+  if (recycled == recycledItems_.end())
+    return createItem(event, scene);
+
+  // unstepEvent or prebuildItems already made the item for this event. Reuse it, which is the same as creating it.
+  auto item = recycled->second;
+  recycledItems_.erase(recycled);
+  // Flash like a new item. Adding the item to the scene adds it to the flashing items.
+  item->borderFlashCountdown_ = AeraVisualizerScene::FLASH_COUNT;
+  return item;
+}
+
+void AeraVisualizerWindow::startPrebuild()
+{
+  trimRecycledItems();
+  if (prebuildTimerId_ == 0)
+    // A zero timer runs when the event loop is idle.
+    prebuildTimerId_ = startTimer(0);
+}
+
+void AeraVisualizerWindow::prebuildItems()
+{
+  // Don't prebuild the events which were already stepped.
+  iPrebuildEvent_ = max(iPrebuildEvent_, iNextEvent_);
+
+  if (iNextEvent_ < events_.size()) {
+    auto prebuildEndTime = getPrebuildEndTime();
+
+    QElapsedTimer elapsed;
+    elapsed.start();
+    while (iPrebuildEvent_ < events_.size() && events_[iPrebuildEvent_]->time_ < prebuildEndTime) {
+      if (elapsed.elapsed() >= 10)
+        // Let the event loop run. Continue on the next timer event.
+        return;
+
+      AeraEvent* event = events_[iPrebuildEvent_].get();
+      ++iPrebuildEvent_;
+      if (newItemEventTypes_.find(event->eventType_) == newItemEventTypes_.end() ||
+          recycledItems_.find(event) != recycledItems_.end())
+        continue;
+      if (event->eventType_ == AutoFocusNewObjectEvent::EVENT_TYPE && event->time_ == replicodeObjects_.getTimeReference())
+        // stepEvent skips these.
+        continue;
+
+      auto item = createItem(event, getSceneForEvent(event));
+      if (item)
+        recycledItems_[event] = item;
+    }
+  }
+
+  killTimer(prebuildTimerId_);
+  prebuildTimerId_ = 0;
+}
+
+Timestamp AeraVisualizerWindow::getPrebuildEndTime()
+{
+  // The end of prebuildFrameCount_ frames, starting with the frame of the next event.
+  auto nextEventTime = events_[iNextEvent_]->time_;
+  auto relativeTime = duration_cast<microseconds>(nextEventTime - replicodeObjects_.getTimeReference());
+  return nextEventTime - (relativeTime % replicodeObjects_.getSamplingPeriod()) +
+    prebuildFrameCount_ * replicodeObjects_.getSamplingPeriod();
+}
+
+void AeraVisualizerWindow::trimRecycledItems()
+{
+  // Keep the items for the events which prebuildItems would make. Delete the others.
+  Timestamp keepStartTime = Utils_MaxTime, keepEndTime = Utils_MaxTime;
+  if (iNextEvent_ < events_.size()) {
+    keepStartTime = events_[iNextEvent_]->time_;
+    keepEndTime = getPrebuildEndTime();
+  }
+
+  set<AeraGraphicsItem*> deletedItems;
+  for (auto entry = recycledItems_.begin(); entry != recycledItems_.end(); ) {
+    if (entry->first->time_ >= keepStartTime && entry->first->time_ < keepEndTime)
+      ++entry;
+    else {
+      deletedItems.insert(entry->second);
+      entry = recycledItems_.erase(entry);
+    }
+  }
+
+  if (deletedItems.size() > 0) {
+    deleteDetachedItems(deletedItems);
+    // Let prebuildItems check the events again.
+    iPrebuildEvent_ = iNextEvent_;
+  }
+}
+
 Timestamp AeraVisualizerWindow::stepEvent(Timestamp maximumTime)
 {
   if (iNextEvent_ >= events_.size())
@@ -1025,8 +1210,7 @@ Timestamp AeraVisualizerWindow::stepEvent(Timestamp maximumTime)
   // Report the change in time to the find dialog
   findDialog_->reportStepEvent();
 
-  auto relativeTime = duration_cast<microseconds>(event->time_ - replicodeObjects_.getTimeReference());
-  auto frameStartTime = event->time_ - (relativeTime % replicodeObjects_.getSamplingPeriod());
+  auto frameStartTime = event->frameStartTime_;
   bool isNewFrame = (iNextEvent_ <= 0 || frameStartTime > events_[iNextEvent_ - 1]->time_);
   if (isNewFrame) {
     auto thisFrameMaxTime = frameStartTime + replicodeObjects_.getSamplingPeriod() - microseconds(1);
@@ -1095,29 +1279,16 @@ Timestamp AeraVisualizerWindow::stepEvent(Timestamp maximumTime)
     AeraGraphicsItem* newItem;
     bool visible = true;
 
-    AeraVisualizerScene* scene;
-    if (event->eventType_ == NewModelEvent::EVENT_TYPE ||
-      event->eventType_ == NewCompositeStateEvent::EVENT_TYPE)
-      scene = modelsScene_;
-    else
-      scene = mainScene_;
-
-    if (event->eventType_ == NewModelEvent::EVENT_TYPE) {
-      auto newModelEvent = (NewModelEvent*)event;
+    AeraVisualizerScene* scene = getSceneForEvent(event);
 
-      // Restore the evidence count, success rate and strength in case we did a rewind.
-      newModelEvent->object_->code(MDL_STRENGTH) = Atom::Float(newModelEvent->strength_);
-      newModelEvent->object_->code(MDL_CNT) = Atom::Float(newModelEvent->evidenceCount_);
-      newModelEvent->object_->code(MDL_SR) = Atom::Float(newModelEvent->successRate_);
-
-      newItem = new ModelItem(newModelEvent, replicodeObjects_, scene);
-    }
+    if (event->eventType_ == NewModelEvent::EVENT_TYPE)
+      newItem = newOrRecycledItem((NewModelEvent*)event, scene);
     else if (event->eventType_ == NewCompositeStateEvent::EVENT_TYPE)
-      newItem = new CompositeStateItem((NewCompositeStateEvent*)event, replicodeObjects_, scene);
+      newItem = newOrRecycledItem((NewCompositeStateEvent*)event, scene);
     else if (event->eventType_ == NewReductionMarkerEvent::EVENT_TYPE) {
       auto newReductionMarkerEvent = (NewReductionMarkerEvent*)event;
 
-      newItem = new ReductionMarkerItem(newReductionMarkerEvent, replicodeObjects_, scene);
+      newItem = newOrRecycledItem(newReductionMarkerEvent, scene);
 
       visible = (nonSimulationsCheckBox_->checkState() == Qt::Checked);
     }
@@ -1129,22 +1300,21 @@ Timestamp AeraVisualizerWindow::stepEvent(Timestamp maximumTime)
         return stepEvent(maximumTime);
       }
 
-      newItem = new AutoFocusFactItem(autoFocusEvent, replicodeObjects_, scene);
+      newItem = newOrRecycledItem(autoFocusEvent, scene);
 
       // Add an arrow to the "from object".
       auto fromObjectItem = scene->getAeraGraphicsItem(autoFocusEvent->fromObject_);
       if (fromObjectItem)
         scene->addArrow(fromObjectItem, newItem);
 
-      auto mkVal = autoFocusEvent->fromObject_->get_reference(0);
-      if (essencePropertyObject_ && mkVal->references_size() >= 2 && mkVal->get_reference(1) == essencePropertyObject_)
+      if (autoFocusEvent->isEssenceFact_)
         visible = ((nonSimulationsCheckBox_->checkState() == Qt::Checked) && (essenceFactsCheckBox_->checkState() == Qt::Checked));
       else
         visible = (nonSimulationsCheckBox_->checkState() == Qt::Checked);
     }
     else if (event->eventType_ == ModelMkValPredictionReduction::EVENT_TYPE) {
       auto reductionEvent = (ModelMkValPredictionReduction*)event;
-      newItem = new PredictionItem(reductionEvent, replicodeObjects_, scene);
+      newItem = newOrRecycledItem(reductionEvent, scene);
 
       // Add an arrow to the cause.
       auto causeItem = scene->getAeraGraphicsItem(reductionEvent->getCause());
@@ -1162,7 +1332,7 @@ Timestamp AeraVisualizerWindow::stepEvent(Timestamp maximumTime)
     }
     else if (event->eventType_ == ModelImdlPredictionEvent::EVENT_TYPE) {
       auto reductionEvent = (ModelImdlPredictionEvent*)event;
-      newItem = new ModelImdlPredictionItem(reductionEvent, replicodeObjects_, scene);
+      newItem = newOrRecycledItem(reductionEvent, scene);
 
       // Add an arrow to the cause.
       auto causeItem = scene->getAeraGraphicsItem(reductionEvent->cause_);
@@ -1174,7 +1344,7 @@ Timestamp AeraVisualizerWindow::stepEvent(Timestamp maximumTime)
     }
     else if (event->eventType_ == ModelGoalReduction::EVENT_TYPE) {
       auto reductionEvent = (ModelGoalReduction*)event;
-      newItem = new ModelGoalItem(reductionEvent, replicodeObjects_, scene);
+      newItem = newOrRecycledItem(reductionEvent, scene);
 
       // Add an arrow to the fact super goal.
       auto factSuperGoalItem = scene->getAeraGraphicsItem(reductionEvent->factSuperGoal_);
@@ -1189,7 +1359,7 @@ Timestamp AeraVisualizerWindow::stepEvent(Timestamp maximumTime)
     }
     else if (event->eventType_ == CompositeStateGoalReduction::EVENT_TYPE) {
       auto reductionEvent = (CompositeStateGoalReduction*)event;
-      newItem = new CompositeStateGoalItem(reductionEvent, replicodeObjects_, scene);
+      newItem = newOrRecycledItem(reductionEvent, scene);
 
       // Add an arrow to the fact super goal.
       auto factSuperGoalItem = scene->getAeraGraphicsItem(reductionEvent->factSuperGoal_);
@@ -1204,7 +1374,7 @@ Timestamp AeraVisualizerWindow::stepEvent(Timestamp maximumTime)
     }
     else if (event->eventType_ == ModelSimulatedPredictionReduction::EVENT_TYPE) {
       auto reductionEvent = (ModelSimulatedPredictionReduction*)event;
-      newItem = new ModelPredictionItem(reductionEvent, replicodeObjects_, scene);
+      newItem = newOrRecycledItem(reductionEvent, scene);
 
       // Add an arrow to the input fact.
       auto inputItem = scene->getAeraGraphicsItem(reductionEvent->input_);
@@ -1234,7 +1404,7 @@ Timestamp AeraVisualizerWindow::stepEvent(Timestamp maximumTime)
     }
     else if (event->eventType_ == ModelSimulatedPredictionReductionFromGoalRequirement::EVENT_TYPE) {
       auto reductionEvent = (ModelSimulatedPredictionReductionFromGoalRequirement*)event;
-      newItem = new ModelPredictionFromRequirementItem(reductionEvent, replicodeObjects_, scene);
+      newItem = newOrRecycledItem(reductionEvent, scene);
 
       // Add an arrow to the input fact.
       auto inputItem = scene->getAeraGraphicsItem(reductionEvent->input_);
@@ -1254,7 +1424,7 @@ Timestamp AeraVisualizerWindow::stepEvent(Timestamp maximumTime)
     }
     else if (event->eventType_ == ModelPredictionFromRequirementDisabledEvent::EVENT_TYPE) {
       auto requirementDisabledEvent = (ModelPredictionFromRequirementDisabledEvent*)event;
-      newItem = new ModelPredictionFromRequirementDisabledItem(requirementDisabledEvent, replicodeObjects_, scene);
+      newItem = newOrRecycledItem(requirementDisabledEvent, scene);
 
       // Add an arrow to the input fact.
       auto inputItem = scene->getAeraGraphicsItem(requirementDisabledEvent->input_);
@@ -1280,7 +1450,7 @@ Timestamp AeraVisualizerWindow::stepEvent(Timestamp maximumTime)
     }
     else if (event->eventType_ == CompositeStateSimulatedPredictionReduction::EVENT_TYPE) {
       auto reductionEvent = (CompositeStateSimulatedPredictionReduction*)event;
-      newItem = new CompositeStatePredictionItem(reductionEvent, replicodeObjects_, scene);
+      newItem = newOrRecycledItem(reductionEvent, scene);
 
       // Add an arrow to the input fact.
       auto inputItem = scene->getAeraGraphicsItem(reductionEvent->input_);
@@ -1307,12 +1477,12 @@ Timestamp AeraVisualizerWindow::stepEvent(Timestamp maximumTime)
         visible = (nonSimulationsCheckBox_->checkState() == Qt::Checked);
     }
     else if (event->eventType_ == PredictionResultEvent::EVENT_TYPE) {
-      newItem = new PredictionResultItem((PredictionResultEvent*)event, replicodeObjects_, scene);
+      newItem = newOrRecycledItem((PredictionResultEvent*)event, scene);
       visible = (nonSimulationsCheckBox_->checkState() == Qt::Checked);
     }
     else if (event->eventType_ == NewInstantiatedCompositeStateEvent::EVENT_TYPE) {
       auto newIcstEvent = (NewInstantiatedCompositeStateEvent*)event;
-      newItem = new InstantiatedCompositeStateItem(newIcstEvent, replicodeObjects_, scene);
+      newItem = newOrRecycledItem(newIcstEvent, scene);
 
       // Add arrows to inputs.
       for (int i = 0; i < newIcstEvent->inputs_.size(); ++i) {
@@ -1326,7 +1496,7 @@ Timestamp AeraVisualizerWindow::stepEvent(Timestamp maximumTime)
     }
     else if (event->eventType_ == NewPredictedInstantiatedCompositeStateEvent::EVENT_TYPE) {
       auto newIcstEvent = (NewPredictedInstantiatedCompositeStateEvent*)event;
-      newItem = new PredictedInstantiatedCompositeStateItem(newIcstEvent, replicodeObjects_, scene);
+      newItem = newOrRecycledItem(newIcstEvent, scene);
 
       // Add arrows to inputs.
       for (int i = 0; i < newIcstEvent->inputs_.size(); ++i) {
@@ -1341,17 +1511,17 @@ Timestamp AeraVisualizerWindow::stepEvent(Timestamp maximumTime)
     else if (event->eventType_ == IoDeviceInjectEvent::EVENT_TYPE ||
              event->eventType_ == IoDeviceEjectEvent::EVENT_TYPE)
       // TODO: Position the IoDeviceInjectEvent at its injectionTime?
-      newItem = new IoDeviceInjectEjectItem(event, replicodeObjects_, scene);
+      newItem = newOrRecycledItem(event, scene);
     else if (event->eventType_ == DriveInjectEvent::EVENT_TYPE) {
       auto driveInject = (DriveInjectEvent*)event;
-      newItem = new DriveItem(driveInject, replicodeObjects_, scene);
+      newItem = newOrRecycledItem(driveInject, scene);
 
       scene->addHorizontalLine(newItem);
       visible = (simulationsCheckBox_->checkState() == Qt::Checked);
     }
     else if (event->eventType_ == SimulationCommitEvent::EVENT_TYPE) {
       auto commitEvent = (SimulationCommitEvent*)event;
-      newItem = new SimulationCommitItem(commitEvent, replicodeObjects_, scene);
+      newItem = newOrRecycledItem(commitEvent, scene);
 
       // Add an arrow to the input Success.
       auto factPredFactSuccessItem = scene->getAeraGraphicsItem(commitEvent->factPredFactSuccess_);
@@ -1365,7 +1535,7 @@ Timestamp AeraVisualizerWindow::stepEvent(Timestamp maximumTime)
     }
     else if (event->eventType_ == PromotedSimulatedPredictionEvent::EVENT_TYPE) {
       auto promotedPredictionEvent = (PromotedSimulatedPredictionEvent*)event;
-      newItem = new PromotedPredictionItem(promotedPredictionEvent, replicodeObjects_, scene);
+      newItem = newOrRecycledItem(promotedPredictionEvent, scene);
 
       // Add an arrow to the input fact.
       auto inputItem = scene->getAeraGraphicsItem(promotedPredictionEvent->timingsFact_);
@@ -1386,7 +1556,7 @@ Timestamp AeraVisualizerWindow::stepEvent(Timestamp maximumTime)
     }
     else if (event->eventType_ == PromotedSimulatedPredictionDefeatEvent::EVENT_TYPE) {
       auto defeatEvent = (PromotedSimulatedPredictionDefeatEvent*)event;
-      newItem = new PromotedPredictionDefeatedItem(defeatEvent, replicodeObjects_, scene);
+      newItem = newOrRecycledItem(defeatEvent, scene);
 
       // Add an arrow from the input fact.
       auto inputItem = scene->getAeraGraphicsItem(defeatEvent->input_);
@@ -1404,7 +1574,7 @@ Timestamp AeraVisualizerWindow::stepEvent(Timestamp maximumTime)
     }
     else if (event->eventType_ == AbaAddSentence::EVENT_TYPE) {
       auto addEvent = (AbaAddSentence*)event;
-      newItem = new AbaSentenceItem(addEvent, replicodeObjects_, scene);
+      newItem = newOrRecycledItem(addEvent, scene);
 
       // Add an arrow to the parent fact.
       auto parentItem = scene->getAeraGraphicsItem(addEvent->parent_);
@@ -1426,7 +1596,7 @@ Timestamp AeraVisualizerWindow::stepEvent(Timestamp maximumTime)
     }
     else if (event->eventType_ == NewInstantiatedModelEvent::EVENT_TYPE) {
       auto newImdlEvent = (NewInstantiatedModelEvent*)event;
-      newItem = new ImdlItem(newImdlEvent, replicodeObjects_, scene);
+      newItem = newOrRecycledItem(newImdlEvent, scene);
 
       visible = ((instantiatedModelsCheckBox_->checkState() == Qt::Checked));
 
@@ -1440,6 +1610,10 @@ Timestamp AeraVisualizerWindow::stepEvent(Timestamp maximumTime)
 
     // Add the new item.
     scene->addAeraGraphicsItem(newItem);
+    UndoRecord record(UndoRecord::ITEM_ADDED, iNextEvent_);
+    record.scene_ = scene;
+    record.item_ = newItem;
+    undoJournal_.push_back(record);
     if (newItem->getAeraEvent()->eventType_ == AbaAddSentence::EVENT_TYPE && bindings_.size() > 0) {
       for (pair<int, QString> pair : bindings_)
         ((AbaSentenceItem*)newItem)->setBinding(pair.first, pair.second);
@@ -1474,47 +1648,39 @@ Timestamp AeraVisualizerWindow::stepEvent(Timestamp maximumTime)
       scene->establishFlashTimer();
   }
   else if (event->eventType_ == SetModelEvidenceCountAndSuccessRateEvent::EVENT_TYPE) {
-    auto setSuccessRateEvent = (SetModelEvidenceCountAndSuccessRateEvent*)event;
+    auto modelItem = dynamic_cast<ModelItem*>(modelsScene_->getAeraGraphicsItem(event->object_));
 
-    // Save the current values for a later undo.
-    setSuccessRateEvent->oldEvidenceCount_ = setSuccessRateEvent->object_->code(MDL_CNT).asFloat();
-    setSuccessRateEvent->oldSuccessRate_ = setSuccessRateEvent->object_->code(MDL_SR).asFloat();
+    if (modelItem) {
+      auto oldEvidenceCount = modelItem->getEvidenceCount();
+      auto oldSuccessRate = modelItem->getSuccessRate();
 
-    // Update the model.
-    setSuccessRateEvent->object_->code(MDL_CNT) = Atom::Float(setSuccessRateEvent->evidenceCount_);
-    setSuccessRateEvent->object_->code(MDL_SR) = Atom::Float(setSuccessRateEvent->successRate_);
+      // Save the sequence number of the shown values for a later undo, then show the values after this event.
+      journalModelValues(modelItem);
+      modelItem->updateFromModel(iNextEvent_ + 1);
 
-    auto modelItem = dynamic_cast<ModelItem*>(modelsScene_->getAeraGraphicsItem(setSuccessRateEvent->object_));
-    if (modelItem) {
-      modelItem->updateFromModel();
-      if (setSuccessRateEvent->evidenceCount_ != setSuccessRateEvent->oldEvidenceCount_ &&
-          setSuccessRateEvent->successRate_ == setSuccessRateEvent->oldSuccessRate_)
+      if (modelItem->getEvidenceCount() != oldEvidenceCount &&
+          modelItem->getSuccessRate() == oldSuccessRate)
         // Only the evidence count changed.
-        modelItem->evidenceCountFlashCountdown_ = AeraVisualizerScene::FLASH_COUNT;
-      else if (setSuccessRateEvent->evidenceCount_ == setSuccessRateEvent->oldEvidenceCount_ &&
-        setSuccessRateEvent->successRate_ != setSuccessRateEvent->oldSuccessRate_)
+        modelItem->setEvidenceCountFlashCountdown(AeraVisualizerScene::FLASH_COUNT);
+      else if (modelItem->getEvidenceCount() == oldEvidenceCount &&
+        modelItem->getSuccessRate() != oldSuccessRate)
         // Only the success rate changed.
-        modelItem->successRateFlashCountdown_ = AeraVisualizerScene::FLASH_COUNT;
+        modelItem->setSuccessRateFlashCountdown(AeraVisualizerScene::FLASH_COUNT);
       else {
-        modelItem->evidenceCountFlashCountdown_ = AeraVisualizerScene::FLASH_COUNT;
-        modelItem->successRateFlashCountdown_ = AeraVisualizerScene::FLASH_COUNT;
+        modelItem->setEvidenceCountFlashCountdown(AeraVisualizerScene::FLASH_COUNT);
+        modelItem->setSuccessRateFlashCountdown(AeraVisualizerScene::FLASH_COUNT);
       }
       modelsScene_->establishFlashTimer();
     }
   }
   else if (event->eventType_ == SetModelStrengthEvent::EVENT_TYPE) {
-    auto setStrengthEvent = (SetModelStrengthEvent*)event;
-
-    // Save the current values for a later undo.
-    setStrengthEvent->oldStrength_ = setStrengthEvent->object_->code(MDL_STRENGTH).asFloat();
-
-    // Update the model.
-    setStrengthEvent->object_->code(MDL_STRENGTH) = Atom::Float(setStrengthEvent->strength_);
+    auto modelItem = dynamic_cast<ModelItem*>(modelsScene_->getAeraGraphicsItem(event->object_));
 
-    auto modelItem = dynamic_cast<ModelItem*>(modelsScene_->getAeraGraphicsItem(setStrengthEvent->object_));
     if (modelItem) {
-      modelItem->updateFromModel();
-      modelItem->strengthFlashCountdown_ = AeraVisualizerScene::FLASH_COUNT;
+      // Save the sequence number of the shown values for a later undo, then show the values after this event.
+      journalModelValues(modelItem);
+      modelItem->updateFromModel(iNextEvent_ + 1);
+      modelItem->setStrengthFlashCountdown(AeraVisualizerScene::FLASH_COUNT);
       modelsScene_->establishFlashTimer();
     }
   }
@@ -1522,34 +1688,38 @@ Timestamp AeraVisualizerWindow::stepEvent(Timestamp maximumTime)
     auto modelItem = dynamic_cast<ModelItem*>(modelsScene_->getAeraGraphicsItem(event->object_));
     if (modelItem)
       // Set the background color.
-      modelItem->setBrush(Qt::white);
+      setBrushWithUndo(modelItem, Qt::white);
   }
   else if (event->eventType_ == PhaseOutModelEvent::EVENT_TYPE) {
     auto modelItem = dynamic_cast<ModelItem*>(modelsScene_->getAeraGraphicsItem(event->object_));
     if (modelItem)
       // Set the background color.
-      modelItem->setBrush(phasedOutModelColor_);
+      setBrushWithUndo(modelItem, phasedOutModelColor_);
   }
   else if (event->eventType_ == DeleteModelEvent::EVENT_TYPE) {
     auto modelItem = dynamic_cast<ModelItem*>(modelsScene_->getAeraGraphicsItem(event->object_));
     if (modelItem)
       // Set the background color.
-      modelItem->setBrush(Qt::gray);
+      setBrushWithUndo(modelItem, Qt::gray);
   }
   else if (event->eventType_ == AbaMarkSentence::EVENT_TYPE) {
     auto markEvent = (AbaMarkSentence*)event;
     auto sentenceItem = dynamic_cast<AbaSentenceItem*>(mainScene_->getAeraGraphicsItem(markEvent->fact_));
     if (sentenceItem) {
+      UndoRecord record(UndoRecord::STATUS_CHANGED, iNextEvent_);
+      record.item_ = sentenceItem;
+      record.status_ = sentenceItem->getStatus();
+      undoJournal_.push_back(record);
       sentenceItem->setStatus(AeraGraphicsItem::STATUS_DONE);
       if (sentenceItem->isVisible()) {
-        sentenceItem->borderFlashCountdown_ = AeraVisualizerScene::FLASH_COUNT;
+        sentenceItem->setBorderFlashCountdown(AeraVisualizerScene::FLASH_COUNT);
         mainScene_->establishFlashTimer();
       }
 
       if (markEvent->alsoMarkGraph_ && sentenceItem->getAeraEvent()->eventType_ == AbaAddSentence::EVENT_TYPE) {
         auto graph = mainScene_->getItemGroup(((AbaAddSentence*)sentenceItem->getAeraEvent())->graphId_);
         if (graph)
-          graph->setBrush(AeraGraphicsItem::Color_opponent_finished_justification);
+          setBrushWithUndo(graph, AeraGraphicsItem::Color_opponent_finished_justification);
       }
     }
   }
@@ -1558,19 +1728,28 @@ Timestamp AeraVisualizerWindow::stepEvent(Timestamp maximumTime)
       (mainScene_->getAeraGraphicsItem(((AbaMarkedSentenceToParent*)event)->markedFact_));
     auto parentItem = mainScene_->getAeraGraphicsItem(((AbaMarkedSentenceToParent*)event)->parent_);
     if (markedSentenceItem && parentItem) {
+      Arrow* arrow;
       if (markedSentenceItem->isBetweenProponentAndOpponent(parentItem))
-        mainScene_->addArrow(markedSentenceItem, parentItem, Arrow::RedArrowheadPen,
+        arrow = mainScene_->addArrow(markedSentenceItem, parentItem, Arrow::RedArrowheadPen,
           Arrow::RedArrowheadPen, Arrow::RedArrowheadPen);
       else if (markedSentenceItem->isBetweenProponentGraphs(parentItem) ||
                markedSentenceItem->isBetweenOpponentGraphs(parentItem))
-        mainScene_->addArrow(markedSentenceItem, parentItem, Arrow::GreenArrowheadPen,
+        arrow = mainScene_->addArrow(markedSentenceItem, parentItem, Arrow::GreenArrowheadPen,
           Arrow::GreenArrowheadPen, Arrow::GreenArrowheadPen);
       else
-        mainScene_->addArrow(markedSentenceItem, parentItem);
+        arrow = mainScene_->addArrow(markedSentenceItem, parentItem);
+
+      if (arrow) {
+        UndoRecord record(UndoRecord::ARROW_ADDED, iNextEvent_);
+        record.item_ = markedSentenceItem;
+        record.otherItem_ = parentItem;
+        record.arrow_ = arrow;
+        undoJournal_.push_back(record);
+      }
 
       if (markedSentenceItem->isVisible() && parentItem->isVisible()) {
-        markedSentenceItem->borderFlashCountdown_ = AeraVisualizerScene::FLASH_COUNT;
-        parentItem->borderFlashCountdown_ = AeraVisualizerScene::FLASH_COUNT;
+        markedSentenceItem->setBorderFlashCountdown(AeraVisualizerScene::FLASH_COUNT);
+        parentItem->setBorderFlashCountdown(AeraVisualizerScene::FLASH_COUNT);
         mainScene_->establishFlashTimer();
       }
     }
@@ -1579,6 +1758,13 @@ Timestamp AeraVisualizerWindow::stepEvent(Timestamp maximumTime)
     auto bindEvent = (AbaBindVariable*)event;
     auto entry = bindings_.find(bindEvent->varNumber_);
     if (entry == bindings_.end() || entry->second != bindEvent->value_) {
+      UndoRecord record(UndoRecord::BINDING_SET, iNextEvent_);
+      record.varNumber_ = bindEvent->varNumber_;
+      record.hadValue_ = (entry != bindings_.end());
+      if (record.hadValue_)
+        record.value_ = entry->second;
+      undoJournal_.push_back(record);
+
       // TODO: Flash changed items.
       bindings_[bindEvent->varNumber_] = bindEvent->value_;
       mainScene_->abaSetBinding(bindEvent->varNumber_, bindEvent->value_);
@@ -1612,145 +1798,172 @@ Timestamp AeraVisualizerWindow::unstepEvent(Timestamp minimumTime, bool& foundGr
   // Report the change in time to the find dialog
   findDialog_->reportStepEvent();
 
-  AeraEvent* event = events_[iNextEvent_].get();
-  if (newItemEventTypes_.find(event->eventType_) != newItemEventTypes_.end()) {
-    AeraVisualizerScene* scene;
-    if (event->eventType_ == NewModelEvent::EVENT_TYPE ||
-        event->eventType_ == NewCompositeStateEvent::EVENT_TYPE)
-      scene = modelsScene_;
-    else
-      scene = mainScene_;
-
-    // Find the AeraGraphicsItem for this event and remove it.
-    // Note that the event saves the updated item position and will use it when recreating the item.
-    auto aeraGraphicsItem = dynamic_cast<AeraGraphicsItem*>(scene->getAeraGraphicsItem(event->object_));
-    if (aeraGraphicsItem) {
-      foundGraphicsItem = true;
-      aeraGraphicsItem->removeArrowsAndHorizontalLine();
-      scene->removeAeraGraphicsItem(aeraGraphicsItem);
-
-      // If this item was highlighted, remove it and null it out
-      if (scene->currentMatch_ == aeraGraphicsItem)
-        scene->currentMatch_ = NULL;
-      for (int i = 0; i < scene->allMatches_.size(); i++) {
-        if (scene->allMatches_.at(i) == aeraGraphicsItem)
-          scene->allMatches_.erase(scene->allMatches_.begin() + i);
-      }
+  if (undoJournal_.size() == 0 || undoJournal_.back().iEvent_ < iNextEvent_)
+    // stepEvent didn't change anything for this event, so skip it.
+    return unstepEvent(minimumTime, foundGraphicsItem);
 
-      delete aeraGraphicsItem;
-    }
-  }
-  else if (event->eventType_ == SetModelEvidenceCountAndSuccessRateEvent::EVENT_TYPE) {
-    // Find the ModelItem for this event and set to the old evidence count and success rate.
-    auto setSuccessRateEvent = (SetModelEvidenceCountAndSuccessRateEvent*)event;
+  // Undo the changes in the reverse order that stepEvent made them.
+  while (undoJournal_.size() > 0 && undoJournal_.back().iEvent_ >= iNextEvent_)
+    undoLastRecord(foundGraphicsItem);
 
-    setSuccessRateEvent->object_->code(MDL_CNT) = Atom::Float(setSuccessRateEvent->oldEvidenceCount_);
-    setSuccessRateEvent->object_->code(MDL_SR) = Atom::Float(setSuccessRateEvent->oldSuccessRate_);
+  if (iNextEvent_ > 0)
+    return events_[iNextEvent_ - 1]->time_;
+  else
+    // The caller will use the time reference.
+    return Timestamp(seconds(0));
+}
 
-    auto modelItem = dynamic_cast<ModelItem*>(modelsScene_->getAeraGraphicsItem(setSuccessRateEvent->object_));
-    if (modelItem) {
-      if (setSuccessRateEvent->evidenceCount_ != setSuccessRateEvent->oldEvidenceCount_ &&
-          setSuccessRateEvent->successRate_ == setSuccessRateEvent->oldSuccessRate_)
-        // Only the evidence count changed.
-        modelItem->evidenceCountFlashCountdown_ = AeraVisualizerScene::FLASH_COUNT;
-      else if (setSuccessRateEvent->evidenceCount_ == setSuccessRateEvent->oldEvidenceCount_ &&
-               setSuccessRateEvent->successRate_ != setSuccessRateEvent->oldSuccessRate_)
-        // Only the success rate changed.
-        modelItem->successRateFlashCountdown_ = AeraVisualizerScene::FLASH_COUNT;
-      else {
-        modelItem->evidenceCountFlashCountdown_ = AeraVisualizerScene::FLASH_COUNT;
-        modelItem->successRateFlashCountdown_ = AeraVisualizerScene::FLASH_COUNT;
-      }
+void AeraVisualizerWindow::journalModelValues(ModelItem* modelItem)
+{
+  UndoRecord record(UndoRecord::MODEL_VALUES_CHANGED, iNextEvent_);
+  record.item_ = modelItem;
+  record.valuesSequence_ = modelItem->getValuesSequence();
+  undoJournal_.push_back(record);
+}
 
-      modelItem->updateFromModel();
-      modelsScene_->establishFlashTimer();
-    }
+void AeraVisualizerWindow::setBrushWithUndo(QAbstractGraphicsShapeItem* item, const QBrush& brush)
+{
+  UndoRecord record(UndoRecord::BRUSH_CHANGED, iNextEvent_);
+  record.shapeItem_ = item;
+  record.brush_ = item->brush();
+  undoJournal_.push_back(record);
+  item->setBrush(brush);
+}
+
+void AeraVisualizerWindow::removeSimulationItems(size_t iEvent)
+{
+  vector<AeraGraphicsItem*> removedItems;
+  mainScene_->removeAllItemsByEventType(simulationEventTypes_, removedItems);
+  if (removedItems.size() == 0)
+    return;
+
+  removedItemRecordStarts_.push_back(undoJournal_.size());
+  for (auto item = removedItems.begin(); item != removedItems.end(); ++item) {
+    UndoRecord record(UndoRecord::ITEM_REMOVED, iEvent);
+    record.scene_ = mainScene_;
+    record.item_ = *item;
+    undoJournal_.push_back(record);
   }
-  else if (event->eventType_ == SetModelStrengthEvent::EVENT_TYPE) {
-    // Find the ModelItem for this event and set to the old strength.
-    auto setStrengthEvent = (SetModelStrengthEvent*)event;
 
-    setStrengthEvent->object_->code(MDL_STRENGTH) = Atom::Float(setStrengthEvent->oldStrength_);
+  trimRemovedItems();
+}
 
-    auto modelItem = dynamic_cast<ModelItem*>(modelsScene_->getAeraGraphicsItem(setStrengthEvent->object_));
-    if (modelItem) {
-      modelItem->strengthFlashCountdown_ = AeraVisualizerScene::FLASH_COUNT;
+void AeraVisualizerWindow::trimRemovedItems()
+{
+  while (removedItemRecordStarts_.size() > keptRemovedItemFrameCount_) {
+    size_t iStart = removedItemRecordStarts_.front();
+    removedItemRecordStarts_.pop_front();
+
+    // The ITEM_REMOVED records of one frame are together with the same iEvent_.
+    set<AeraGraphicsItem*> deletedItems;
+    size_t iEnd = iStart;
+    while (iEnd < undoJournal_.size() && undoJournal_[iEnd].type_ == UndoRecord::ITEM_REMOVED &&
+           undoJournal_[iEnd].iEvent_ == undoJournal_[iStart].iEvent_) {
+      deletedItems.insert(undoJournal_[iEnd].item_);
+      ++iEnd;
+    }
+
+    // A simulation item is only in the scene for one frame, so the records which refer to it are
+    // after the ones which were already checked.
+    for (size_t i = trimmedRecordsEnd_; i < iEnd; ++i) {
+      auto& record = undoJournal_[i];
+      if (deletedItems.find(record.item_) != deletedItems.end() ||
+          deletedItems.find(record.otherItem_) != deletedItems.end() ||
+          deletedItems.find(dynamic_cast<AeraGraphicsItem*>(record.shapeItem_)) != deletedItems.end())
+        record.type_ = UndoRecord::NONE;
+    }
+    trimmedRecordsEnd_ = iEnd;
+
+    if (deletedItems.find(hoverHighlightItem_) != deletedItems.end())
+      hoverHighlightItem_ = 0;
+    deleteDetachedItems(deletedItems);
+  }
+}
 
-      modelItem->updateFromModel();
-      modelsScene_->establishFlashTimer();
+void AeraVisualizerWindow::deleteDetachedItems(const set<AeraGraphicsItem*>& items)
+{
+  // detachArrowsAndHorizontalLine left the arrows in the item's list, so this recycles them.
+  for (auto item = items.begin(); item != items.end(); ++item)
+    (*item)->removeArrowsAndHorizontalLine();
+  for (auto item = items.begin(); item != items.end(); ++item)
+    delete *item;
+}
+
+void AeraVisualizerWindow::undoLastRecord(bool& foundGraphicsItem)
+{
+  UndoRecord record = undoJournal_.back();
+  undoJournal_.pop_back();
+  if (removedItemRecordStarts_.size() > 0 && removedItemRecordStarts_.back() >= undoJournal_.size())
+    // This was the first ITEM_REMOVED record of its frame.
+    removedItemRecordStarts_.pop_back();
+  trimmedRecordsEnd_ = min(trimmedRecordsEnd_, undoJournal_.size());
+
+  if (record.type_ == UndoRecord::ITEM_ADDED) {
+    // Note that the event saves the updated item position and will use it when stepping the event again.
+    foundGraphicsItem = true;
+    if (record.item_ == hoverHighlightItem_) {
+      // Restore the item before recycling it, the same as textItemHoverMoveEvent.
+      hoverHighlightItem_->setPen(hoverHighlightItem_->getBorderNoHighlightPen());
+      hoverHighlightItem_->setItemAndArrowsAndHorizontalLineVisible(hoverHighlightItemWasVisible_);
+      hoverHighlightItem_ = 0;
     }
+    record.item_->removeArrowsAndHorizontalLine();
+    record.scene_->removeAeraGraphicsItem(record.item_);
+    record.item_->setSelected(false);
+    if (record.scene_->isMainScene())
+      // Only keep the item's size until it is stepped again. trimRecycledItems deletes it if it is not soon.
+      record.item_->dehydrate();
+    // Keep the item so that stepping the same event again reuses it.
+    recycledItems_[record.item_->getAeraEvent()] = record.item_;
   }
-  else if (event->eventType_ == PhaseInModelEvent::EVENT_TYPE) {
-    // Find the ModelItem for this event and set its appearance to not phased out.
-    auto modelItem = dynamic_cast<ModelItem*>(modelsScene_->getAeraGraphicsItem(event->object_));
-    if (modelItem)
-      // Set the background color. Assume the model was phased out before phase in.
-      modelItem->setBrush(phasedOutModelColor_);
-  }
-  else if (event->eventType_ == PhaseOutModelEvent::EVENT_TYPE) {
-    // Find the ModelItem for this event and set its appearance to not phased out.
-    auto modelItem = dynamic_cast<ModelItem*>(modelsScene_->getAeraGraphicsItem(event->object_));
-    if (modelItem)
-      // Set the background color.
-      modelItem->setBrush(Qt::white);
-  }
-  else if (event->eventType_ == DeleteModelEvent::EVENT_TYPE) {
-    // Find the ModelItem for this event and set its appearance to not deleted.
-    auto modelItem = dynamic_cast<ModelItem*>(modelsScene_->getAeraGraphicsItem(event->object_));
-    if (modelItem)
-      // Set the background color.
-      modelItem->setBrush(Qt::white);
-  }
-  else if (event->eventType_ == AbaMarkSentence::EVENT_TYPE) {
-    auto markEvent = (AbaMarkSentence*)event;
-    auto sentenceItem = dynamic_cast<AbaSentenceItem*>(mainScene_->getAeraGraphicsItem(markEvent->fact_));
-    if (sentenceItem) {
-      // Revert to unmarked.
-      sentenceItem->setStatus(AeraGraphicsItem::STATUS_PROCESSING);
-      if (sentenceItem->isVisible()) {
-        sentenceItem->borderFlashCountdown_ = AeraVisualizerScene::FLASH_COUNT;
-        mainScene_->establishFlashTimer();
-      }
+  else if (record.type_ == UndoRecord::ITEM_REMOVED)
+    record.scene_->restoreAeraGraphicsItem(record.item_);
+  else if (record.type_ == UndoRecord::ARROW_ADDED) {
+    record.item_->removeAndDeleteArrow(record.arrow_);
 
-      if (markEvent->alsoMarkGraph_ && sentenceItem->getAeraEvent()->eventType_ == AbaAddSentence::EVENT_TYPE) {
-        auto graph = mainScene_->getItemGroup(((AbaAddSentence*)sentenceItem->getAeraEvent())->graphId_);
-        if (graph)
-          // Revert to unmarked.
-          graph->setBrush(AeraGraphicsItem::Color_opponent_unfinished_justification);
-      }
+    if (record.item_->isVisible() && record.otherItem_->isVisible()) {
+      record.item_->setBorderFlashCountdown(AeraVisualizerScene::FLASH_COUNT);
+      record.otherItem_->setBorderFlashCountdown(AeraVisualizerScene::FLASH_COUNT);
+      mainScene_->establishFlashTimer();
     }
   }
-  else if (event->eventType_ == AbaMarkedSentenceToParent::EVENT_TYPE) {
-    auto markedSentenceItem = dynamic_cast<AbaSentenceItem*>(mainScene_->getAeraGraphicsItem(((AbaMarkedSentenceToParent*)event)->markedFact_));
-    auto parentItem = mainScene_->getAeraGraphicsItem(((AbaMarkedSentenceToParent*)event)->parent_);
-    if (markedSentenceItem) {
-      markedSentenceItem->removeAndDeleteArrowToObject(((AbaMarkedSentenceToParent*)event)->parent_);
-
-      if (parentItem && markedSentenceItem->isVisible() && parentItem->isVisible()) {
-        markedSentenceItem->borderFlashCountdown_ = AeraVisualizerScene::FLASH_COUNT;
-        parentItem->borderFlashCountdown_ = AeraVisualizerScene::FLASH_COUNT;
-        mainScene_->establishFlashTimer();
-      }
+  else if (record.type_ == UndoRecord::BRUSH_CHANGED)
+    record.shapeItem_->setBrush(record.brush_);
+  else if (record.type_ == UndoRecord::STATUS_CHANGED) {
+    ((AbaSentenceItem*)record.item_)->setStatus(record.status_);
+    if (record.item_->isVisible()) {
+      record.item_->setBorderFlashCountdown(AeraVisualizerScene::FLASH_COUNT);
+      mainScene_->establishFlashTimer();
     }
   }
-  else if (event->eventType_ == AbaBindVariable::EVENT_TYPE) {
-    auto bindEvent = (AbaBindVariable*)event;
-    auto entry = bindings_.find(bindEvent->varNumber_);
-    if (entry != bindings_.end()) {
-      // TODO: Flash changed items.
-      bindings_.erase(entry);
-      mainScene_->abaRemoveBinding(bindEvent->varNumber_);
+  else if (record.type_ == UndoRecord::MODEL_VALUES_CHANGED) {
+    auto modelItem = (ModelItem*)record.item_;
+    auto oldStrength = modelItem->getStrength();
+    auto oldEvidenceCount = modelItem->getEvidenceCount();
+    auto oldSuccessRate = modelItem->getSuccessRate();
+
+    modelItem->updateFromModel(record.valuesSequence_);
+
+    // Flash the values which change back.
+    if (modelItem->getStrength() != oldStrength)
+      modelItem->setStrengthFlashCountdown(AeraVisualizerScene::FLASH_COUNT);
+    if (modelItem->getEvidenceCount() != oldEvidenceCount)
+      modelItem->setEvidenceCountFlashCountdown(AeraVisualizerScene::FLASH_COUNT);
+    if (modelItem->getSuccessRate() != oldSuccessRate)
+      modelItem->setSuccessRateFlashCountdown(AeraVisualizerScene::FLASH_COUNT);
+    modelsScene_->establishFlashTimer();
+  }
+  else if (record.type_ == UndoRecord::BINDING_SET) {
+    // TODO: Flash changed items.
+    if (record.hadValue_) {
+      bindings_[record.varNumber_] = record.value_;
+      mainScene_->abaSetBinding(record.varNumber_, record.value_);
+    }
+    else {
+      bindings_.erase(record.varNumber_);
+      mainScene_->abaRemoveBinding(record.varNumber_);
     }
   }
-  else
-    // Skip this event.
-    return unstepEvent(minimumTime, foundGraphicsItem);
-
-  if (iNextEvent_ > 0)
-    return events_[iNextEvent_ - 1]->time_;
-  else
-    // The caller will use the time reference.
-    return Timestamp(seconds(0));
 }
 
 void AeraVisualizerWindow::startPlay()
@@ -1834,6 +2047,18 @@ void AeraVisualizerWindow::setSliderToPlayTime()
     children_[i]->playSlider_->setValue(value);
 }
 
+void AeraVisualizerWindow::beginScenesBatch()
+{
+  mainScene_->beginBatch();
+  modelsScene_->beginBatch();
+}
+
+void AeraVisualizerWindow::commitScenesBatch()
+{
+  modelsScene_->commitBatch();
+  mainScene_->commitBatch();
+}
+
 void AeraVisualizerWindow::playPauseButtonClickedImpl()
 {
   if (isPlaying_)
@@ -1859,11 +2084,13 @@ void AeraVisualizerWindow::stepButtonClickedImpl()
   bool firstEventIsSimulation = 
     (simulationEventTypes_.find(events_[iNextStepEvent]->eventType_) != simulationEventTypes_.end());
 
+  // Add and remove the items of the frame in one batch.
+  beginScenesBatch();
   int iNonSimulation = -1;
   if (isNewFrame) {
-    // Remove the simulation items from the previous frame.
+    // Remove the simulation items from the previous frame. Stepping back over iNextStepEvent restores them.
     // TODO: We don't expect it, but if the first event in the frame is simulated then this will erase it.
-    mainScene_->removeAllItemsByEventType(simulationEventTypes_);
+    removeSimulationItems(iNextStepEvent);
     mainScene_->setFocusSimulationDetailOids(set<int>());
   }
   else {
@@ -1916,18 +2143,24 @@ void AeraVisualizerWindow::stepButtonClickedImpl()
       }
     }
   }
+  commitScenesBatch();
 
   setPlayTime(eventTime);
   setSliderToPlayTime();
+  startPrebuild();
 }
 
 void AeraVisualizerWindow::stepBackButtonClickedImpl()
 {
   stopPlay();
+  // Remove the items of the frame in one batch.
+  beginScenesBatch();
   bool foundGraphicsItem;
   auto newTime = max(unstepEvent(Timestamp(seconds(0)), foundGraphicsItem), replicodeObjects_.getTimeReference());
-  if (newTime == Utils_MaxTime)
+  if (newTime == Utils_MaxTime) {
+    commitScenesBatch();
     return;
+  }
   // Debug: How to step the children also?
 
   // Keep unstepping remaining events in this same frame.
@@ -1944,9 +2177,11 @@ void AeraVisualizerWindow::stepBackButtonClickedImpl()
       break;
     newTime = localNewTime;
   }
+  commitScenesBatch();
 
   setPlayTime(max(newTime, replicodeObjects_.getTimeReference()));
   setSliderToPlayTime();
+  startPrebuild();
 }
 
 void AeraVisualizerWindow::playTimeLabelClickedImpl()
@@ -1959,6 +2194,11 @@ void AeraVisualizerWindow::timerEvent(QTimerEvent* event)
 {
   // TODO: Make sure we don't re-enter.
 
+  if (event->timerId() == prebuildTimerId_) {
+    prebuildItems();
+    return;
+  }
+
   if (event->timerId() != playTimerId_)
     // This timer event is not for us.
     return;
@@ -1974,7 +2214,9 @@ void AeraVisualizerWindow::timerEvent(QTimerEvent* event)
 
   // Step events while events_[iNextEvent_] is less than or equal to the playTime.
   // Debug: How to step the children also?
+  beginScenesBatch();
   while (stepEvent(playTime) != Utils_MaxTime);
+  commitScenesBatch();
 
   if (iNextEvent_ >= events_.size()) {
     // We have played all events.
@@ -1984,6 +2226,7 @@ void AeraVisualizerWindow::timerEvent(QTimerEvent* event)
 
   setPlayTime(playTime);
   setSliderToPlayTime();
+  startPrebuild();
 }
 
 void AeraVisualizerWindow::closeEvent(QCloseEvent* event) {
@@ -1997,6 +2240,8 @@ void AeraVisualizerWindow::saveMainWindowImage()
   if (!fileName.isNull()) {
     QApplication::setOverrideCursor(Qt::WaitCursor);
     QApplication::processEvents();
+    // Render the items which are far from the viewport too.
+    mainScene_->rehydrateAllAeraGraphicsItems();
 
     // Get the bounding rect including the top-left plus all AeraGraphicsItem. This excludes lines such as frame boundaries.
     QRectF boundingRect(0, 0, 100, 100);
@@ -2156,8 +2401,9 @@ void AeraVisualizerWindow::createToolbars()
     allSimulationInputsCheckBox_->setEnabled(state == Qt::Checked);
     singleStepSimulationCheckBox_->setEnabled(state == Qt::Checked);
 
-    for (auto i = simulationEventTypes_.begin(); i != simulationEventTypes_.end(); ++i)
-      mainScene_->setItemsVisible(*i, state == Qt::Checked);
+    mainScene_->beginBatch();
+    mainScene_->setItemsVisible(simulationEventTypes_, state == Qt::Checked);
+    mainScene_->commitBatch();
     });
   toolbar->addWidget(simulationsCheckBox_);
 
@@ -2180,6 +2426,8 @@ void AeraVisualizerWindow::createToolbars()
     predictedInstantiatedCompositeStatesCheckBox_->setEnabled(state == Qt::Checked);
     requirementsCheckBox_->setEnabled(state == Qt::Checked);
 
+    // Update the scene once for all the changes.
+    mainScene_->beginBatch();
     // Do the opposite of simulationsCheckBox_ .
     mainScene_->setNonItemsVisible(simulationEventTypes_, state == Qt::Checked);
     if (state == Qt::Checked) {
@@ -2192,32 +2440,43 @@ void AeraVisualizerWindow::createToolbars()
       mainScene_->setItemsVisible(
         ModelImdlPredictionEvent::EVENT_TYPE, requirementsCheckBox_->checkState() == Qt::Checked);
     }
+    mainScene_->commitBatch();
   });
   toolbar->addWidget(nonSimulationsCheckBox_);
 
   essenceFactsCheckBox_ = new AeraCheckbox("Essence Facts", SettingsKeyEssenceFactsVisible, this);
   connect(essenceFactsCheckBox_, &QCheckBox::stateChanged, [=](int state) {
-    mainScene_->setAutoFocusItemsVisible("essence", state == Qt::Checked);  });
+    mainScene_->beginBatch();
+    mainScene_->setAutoFocusItemsVisible("essence", state == Qt::Checked);
+    mainScene_->commitBatch(); });
   toolbar->addWidget(essenceFactsCheckBox_);
 
   instantiatedCompositeStatesCheckBox_ = new AeraCheckbox("Instantiated Comp. States", SettingsKeyInstantiatedCompositeStatesVisible, this);
   connect(instantiatedCompositeStatesCheckBox_, &QCheckBox::stateChanged, [=](int state) {
-    mainScene_->setItemsVisible(NewInstantiatedCompositeStateEvent::EVENT_TYPE, state == Qt::Checked); });
+    mainScene_->beginBatch();
+    mainScene_->setItemsVisible(NewInstantiatedCompositeStateEvent::EVENT_TYPE, state == Qt::Checked);
+    mainScene_->commitBatch(); });
   toolbar->addWidget(instantiatedCompositeStatesCheckBox_);
 
   instantiatedModelsCheckBox_ = new AeraCheckbox("Instantiated Models", SettingsKeyInstantiatedModelsVisible, this);
   connect(instantiatedModelsCheckBox_, &QCheckBox::stateChanged, [=](int state) {
-    mainScene_->setItemsVisible(NewInstantiatedModelEvent::EVENT_TYPE, state == Qt::Checked); });
+    mainScene_->beginBatch();
+    mainScene_->setItemsVisible(NewInstantiatedModelEvent::EVENT_TYPE, state == Qt::Checked);
+    mainScene_->commitBatch(); });
   toolbar->addWidget(instantiatedModelsCheckBox_);
 
   predictedInstantiatedCompositeStatesCheckBox_ = new AeraCheckbox("Pred. Instantiated Comp. States", SettingsKeyPredictedInstantiatedCompositeStatesVisible, this);
   connect(predictedInstantiatedCompositeStatesCheckBox_, &QCheckBox::stateChanged, [=](int state) {
-    mainScene_->setItemsVisible(NewPredictedInstantiatedCompositeStateEvent::EVENT_TYPE, state == Qt::Checked); });
+    mainScene_->beginBatch();
+    mainScene_->setItemsVisible(NewPredictedInstantiatedCompositeStateEvent::EVENT_TYPE, state == Qt::Checked);
+    mainScene_->commitBatch(); });
   toolbar->addWidget(predictedInstantiatedCompositeStatesCheckBox_);
 
   requirementsCheckBox_ = new AeraCheckbox("Requirements", SettingsKeyRequirementsVisible, this);
   connect(requirementsCheckBox_, &QCheckBox::stateChanged, [=](int state) {
-    mainScene_->setItemsVisible(ModelImdlPredictionEvent::EVENT_TYPE, state == Qt::Checked);  });
+    mainScene_->beginBatch();
+    mainScene_->setItemsVisible(ModelImdlPredictionEvent::EVENT_TYPE, state == Qt::Checked);
+    mainScene_->commitBatch(); });
   toolbar->addWidget(requirementsCheckBox_);
 }
 
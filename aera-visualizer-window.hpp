@@ -62,6 +62,8 @@
 #include "aera-checkbox.h"
 
 #include <vector>
+#include <deque>
+#include <unordered_map>
 #include <QIcon>
 
 class AeraVisualizerScene;
@@ -79,6 +81,7 @@ namespace aera_visualizer {
 
 class ExplanationLogWindow;
 class FindDialog;
+class ModelItem;
 
 /**
  * AeraVisualizerWindow extends AeraVisualizerWindowBase to present the player
@@ -95,6 +98,11 @@ public:
    */
   AeraVisualizerWindow(ReplicodeObjects& replicodeObjects);
 
+  /**
+   * Delete the items which are kept for undo or reuse but are not in a scene.
+   */
+  ~AeraVisualizerWindow();
+
   /**
    * Scan the runtimeOutputFilePath and add to startupEvents_ and events_. Call this once after creating the window.
    * After showing the window for the first time, you must call addStartupItems().
@@ -131,9 +139,7 @@ public:
 
     // Get the next event and use it to compute the current frame's max time
     AeraEvent* event = events_[iNextEvent_].get();
-    auto relativeTime = std::chrono::duration_cast<std::chrono::microseconds>(event->time_ - replicodeObjects_.getTimeReference());
-    auto frameStartTime = event->time_ - (relativeTime % replicodeObjects_.getSamplingPeriod());
-    Timestamp thisFrameMaxTime = frameStartTime + replicodeObjects_.getSamplingPeriod() - std::chrono::microseconds(1);
+    Timestamp thisFrameMaxTime = event->frameStartTime_ + replicodeObjects_.getSamplingPeriod() - std::chrono::microseconds(1);
 
     return thisFrameMaxTime;
   }
@@ -142,6 +148,7 @@ public:
   /**
    * Check if one of the scenes has an AeraGraphicsItem for the object. You can use this to
    * get the item, or just check if it exists, e.g. such that zoomToAeraGraphicsItem will succeed.
+   * This uses itemRegistry_ so it does not scan the scenes.
    * \param object The Code* object to search for.
    * \param scene (optional) If this returns an item, set *scene to a pointer to the
    * AeraVisualizerScene where it was found. If omitted or NULL, don't set it. 
@@ -174,12 +181,11 @@ public:
     void centerOnAeraGraphicsItem(r_code::Code* object);
 
   /**
-   * Handle hover move events to get the HTML link at the position and highlight the linked item
-   * until the mouse leaves the link.
-   * \param document This calls document->documentLayout()->anchorAt(position) to get the hovered link.
-   * \param position The position relative to the text item from the move event.
+   * Handle a change of the hovered HTML link and highlight the linked item until the mouse
+   * leaves the link.
+   * \param url The hovered link, or "" if the mouse is not on a link.
    */
-  void textItemHoverMoveEvent(const QTextDocument* document, QPointF position);
+  void textItemHoverMoveEvent(const QString& url);
 
   /**
    * Get the AeraEvent at index i in the events list.
@@ -214,7 +220,8 @@ protected:
   Timestamp getINextStepEvent(Timestamp maximumTime, size_t iNextEventStart, size_t& iNextStepEvent);
 
   /**
-   * Perform the event at events_[iNextEvent_] and then increment iNextEvent_.
+   * Perform the event at events_[iNextEvent_] and then increment iNextEvent_. Append an
+   * UndoRecord to undoJournal_ for each change so that unstepEvent can undo it.
    * \param maximumTime If the time of next event is greater than maximumTime, don't perform the
    * event, and return Utils_MaxTime.
    * \return The time of the next event. If there is no next event, then
@@ -223,7 +230,8 @@ protected:
   core::Timestamp stepEvent(core::Timestamp maximumTime);
 
   /**
-   * Decrement iNextEvent_ and undo the event at events_[iNextEvent_].
+   * Decrement iNextEvent_ and undo the event at events_[iNextEvent_] by popping the records
+   * that stepEvent appended to undoJournal_. If the event has no records, skip it.
    * \param minimumTime if the time of previous event is less than minimumTime, don't
    * decrement iNextEvent_ and don't undo, and return Utils_MaxTime.
    * \param Set foundGraphicsItem if the graphics item for the step was found.
@@ -247,6 +255,7 @@ private slots:
 
 private:
   friend class AeraVisualizerWindowBase;
+  friend class AeraVisualizerScene;
   void createActions();
   void createMenus();
   void createToolbars();
@@ -291,6 +300,134 @@ private:
    */
   void abaNewStep(int step);
 
+  /**
+   * Get the scene where stepEvent adds the item for the event.
+   * \param event The event.
+   * \return modelsScene_ or mainScene_.
+   */
+  AeraVisualizerScene* getSceneForEvent(const AeraEvent* event);
+
+  /**
+   * Create the AeraGraphicsItem subclass for the event type.
+   * \param event The event for the item.
+   * \param scene The parent scene for the item.
+   * \return The new item, which is not yet added to the scene, or NULL if the event type doesn't have an item.
+   */
+  AeraGraphicsItem* createItem(AeraEvent* event, AeraVisualizerScene* scene);
+
+  /**
+   * If recycledItems_ has an item for the event, remove it from recycledItems_ and return it.
+   * Otherwise, return createItem(event, scene).
+   * \param event The event for the item.
+   * \param scene The parent scene for a new item.
+   * \return The recycled or new item, which is not yet added to the scene.
+   */
+  AeraGraphicsItem* newOrRecycledItem(AeraEvent* event, AeraVisualizerScene* scene);
+
+  /**
+   * Start the timer which calls prebuildItems when the event loop is idle, if not already started.
+   */
+  void startPrebuild();
+
+  /**
+   * Create the items for the events in the next prebuildFrameCount_ frames and put them in
+   * recycledItems_, so that stepEvent only needs to add them to the scene. To keep the GUI
+   * responsive, this returns after a time slice and continues on the next timer event. When
+   * finished, stop the timer.
+   */
+  void prebuildItems();
+
+  /**
+   * Get the end of the prebuildFrameCount_ frames which prebuildItems makes items for, starting
+   * with the frame of events_[iNextEvent_]. This assumes iNextEvent_ < events_.size().
+   */
+  core::Timestamp getPrebuildEndTime();
+
+  /**
+   * Delete the items in recycledItems_ whose events are not in the frames from getPrebuildEndTime,
+   * so that rewinding a long run does not keep an item for every stepped event.
+   */
+  void trimRecycledItems();
+
+  /**
+   * Add or replace the entry in itemRegistry_ for the object. AeraVisualizerScene calls this
+   * when an item is added to the scene.
+   * \param object The object of the item's getAeraEvent().
+   * \param scene The scene of the item.
+   * \param item The AeraGraphicsItem.
+   */
+  void registerAeraGraphicsItem(r_code::Code* object, AeraVisualizerScene* scene, AeraGraphicsItem* item)
+  {
+    itemRegistry_[object] = ItemRegistration(scene, item);
+  }
+
+  /**
+   * Remove the entry in itemRegistry_ for the object if it is for the item. AeraVisualizerScene
+   * calls this when an item is removed from the scene.
+   * \param object The object of the item's getAeraEvent().
+   * \param item The AeraGraphicsItem.
+   */
+  void unregisterAeraGraphicsItem(r_code::Code* object, AeraGraphicsItem* item)
+  {
+    auto entry = itemRegistry_.find(object);
+    if (entry != itemRegistry_.end() && entry->second.item_ == item)
+      itemRegistry_.erase(entry);
+  }
+
+  /**
+   * Append an UndoRecord to undoJournal_ with the sequence number of the model values which the ModelItem
+   * currently shows, so that unstepEvent can show them again.
+   * \param modelItem The ModelItem whose values stepEvent is about to change.
+   */
+  void journalModelValues(ModelItem* modelItem);
+
+  /**
+   * Append an UndoRecord to undoJournal_ with the current brush of the item, then set the new brush.
+   * \param item The item, e.g. a ModelItem or AeraGraphicsItemGroup.
+   * \param brush The new brush.
+   */
+  void setBrushWithUndo(QAbstractGraphicsShapeItem* item, const QBrush& brush);
+
+  /**
+   * Remove the simulation items from the main scene, and append an UndoRecord for each to
+   * undoJournal_ so that unstepping the event at iEvent adds them back.
+   * \param iEvent The index in events_ of the first event in the new frame.
+   */
+  void removeSimulationItems(size_t iEvent);
+
+  /**
+   * If undoJournal_ keeps the removed simulation items of more than keptRemovedItemFrameCount_
+   * frames, delete the items of the oldest frames so that memory doesn't grow on a long run.
+   * Change each record which refers to a deleted item to NONE, so that unstepping past these
+   * frames doesn't restore the simulation items (stepping forward again creates new ones).
+   */
+  void trimRemovedItems();
+
+  /**
+   * Remove and recycle the arrows and horizontal line of the items, then delete them. The items
+   * must not be in a scene. An arrow between two of the items is only in the list of one, so this
+   * recycles all the arrows before deleting any item.
+   * \param items The items to delete.
+   */
+  void deleteDetachedItems(const std::set<AeraGraphicsItem*>& items);
+
+  /**
+   * Pop the last record from undoJournal_ and revert the change that it records.
+   * \param foundGraphicsItem Set this true if the record removes an item added by stepEvent.
+   */
+  void undoLastRecord(bool& foundGraphicsItem);
+
+  /**
+   * Call beginBatch() on the main scene and models scene, before stepping or unstepping
+   * many events. You must call commitScenesBatch() when done.
+   */
+  void beginScenesBatch();
+
+  /**
+   * Call commitBatch() on the main scene and models scene, to end beginScenesBatch().
+   */
+  void commitScenesBatch();
+
   void playPauseButtonClickedImpl();
   void stepButtonClickedImpl();
   void stepBackButtonClickedImpl();
@@ -346,6 +483,11 @@ private:
   bool showRelativeTime_;
   core::Timestamp playTime_;
   int playTimerId_;
+  int prebuildTimerId_;
+  // The index in events_ of the next event for prebuildItems.
+  size_t iPrebuildEvent_;
+  // The number of frames, starting with the frame of the next event, for prebuildItems.
+  static const int prebuildFrameCount_ = 3;
   bool isPlaying_;
   // Accumulate ABA events here until a solution is found and the entries are copied to events_ .
   std::vector<std::shared_ptr<AeraEvent> > abaEvents_;
@@ -354,6 +496,80 @@ private:
   // abaStepIndexes has the index in abaEvents_ of the step number. See abaNewStep.
   std::vector<size_t> abaStepIndexes_;
   std::map<int, QString> bindings_;
+
+  /**
+   * An UndoRecord is appended to undoJournal_ for each change that stepEvent makes to the scenes,
+   * so that unstepEvent can undo an event by popping its records without searching the scenes.
+   */
+  struct UndoRecord {
+    typedef enum {
+      // The change was to an item which trimRemovedItems deleted, so there is nothing to undo.
+      NONE,
+      // item_ was added to scene_. Undo removes it and puts it in recycledItems_ for stepping the event again.
+      ITEM_ADDED,
+      // item_ was removed from scene_ but not deleted. Undo adds it back.
+      ITEM_REMOVED,
+      // arrow_ was added from item_ to otherItem_. Undo removes and deletes it.
+      ARROW_ADDED,
+      // The brush of shapeItem_ was changed from brush_.
+      BRUSH_CHANGED,
+      // The status of the AbaSentenceItem item_ was changed from status_.
+      STATUS_CHANGED,
+      // The ModelItem item_ was changed from showing the model values at valuesSequence_.
+      MODEL_VALUES_CHANGED,
+      // bindings_[varNumber_] was set. If hadValue_, the previous value was value_, otherwise it was unbound.
+      BINDING_SET
+    } Type;
+
+    UndoRecord(Type type, size_t iEvent)
+      : type_(type), iEvent_(iEvent), scene_(0), item_(0), otherItem_(0), arrow_(0), shapeItem_(0),
+      status_(AeraGraphicsItem::STATUS_PROCESSING), valuesSequence_(0), varNumber_(0), hadValue_(false)
+    {}
+
+    Type type_;
+    // The index in events_ of the event which was stepped to make this change.
+    size_t iEvent_;
+    AeraVisualizerScene* scene_;
+    AeraGraphicsItem* item_;
+    AeraGraphicsItem* otherItem_;
+    Arrow* arrow_;
+    QAbstractGraphicsShapeItem* shapeItem_;
+    QBrush brush_;
+    AeraGraphicsItem::ProcessStatus status_;
+    size_t valuesSequence_;
+    int varNumber_;
+    bool hadValue_;
+    QString value_;
+  };
+
+  struct ItemRegistration {
+    ItemRegistration()
+      : scene_(0), item_(0)
+    {}
+
+    ItemRegistration(AeraVisualizerScene* scene, AeraGraphicsItem* item)
+      : scene_(scene), item_(item)
+    {}
+
+    AeraVisualizerScene* scene_;
+    AeraGraphicsItem* item_;
+  };
+
+  // Key is the object of an item's getAeraEvent(), value is the item and its scene. This covers
+  // the items which are in modelsScene_ or mainScene_.
+  std::unordered_map<r_code::Code*, ItemRegistration> itemRegistry_;
+  // The records of the changes made by stepEvent, in order. unstepEvent pops from the end.
+  std::vector<UndoRecord> undoJournal_;
+  // The number of most recent frames whose removed simulation items undoJournal_ keeps. See trimRemovedItems.
+  static const size_t keptRemovedItemFrameCount_ = 10;
+  // The index in undoJournal_ of the first ITEM_REMOVED record of each frame whose removed
+  // simulation items are kept, oldest first.
+  std::deque<size_t> removedItemRecordStarts_;
+  // The index in undoJournal_ after the records which trimRemovedItems already checked.
+  size_t trimmedRecordsEnd_;
+  // Items which unstepEvent removed or prebuildItems created, for use when stepping the event.
+  // The key is the item's event. trimRecycledItems keeps only the items for the prebuild frames.
+  std::unordered_map<const AeraEvent*, AeraGraphicsItem*> recycledItems_;
   // The AeraEvent types where stepEvent will create a new AeraGraphicsItem.
   static const std::set<int> newItemEventTypes_;
 };
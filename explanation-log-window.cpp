@@ -69,8 +69,10 @@ ExplanationLogWindow::ExplanationLogWindow(AeraVisualizerWindow* mainWindow, Rep
   : AeraVisualizerWindowBase(mainWindow, replicodeObjects)
 {
   auto centralLayout = new QVBoxLayout();
-  textBrowser_ = new TextBrowser(this);
+  textBrowser_ = new QTextBrowser(this);
   connect(textBrowser_, SIGNAL(anchorClicked(const QUrl&)), this, SLOT(textBrowserAnchorClicked(const QUrl&)));
+  // QTextBrowser already finds the link under the mouse and only signals when it changes.
+  connect(textBrowser_, SIGNAL(highlighted(const QUrl&)), this, SLOT(textBrowserHighlighted(const QUrl&)));
   centralLayout->addWidget(textBrowser_);
   centralLayout->addWidget(getPlayerControlPanel());
 
@@ -128,11 +130,7 @@ void ExplanationLogWindow::textBrowserAnchorClicked(const QUrl& url)
       // There is no item for an mk.rdx, so show a menu for a "What Is" explanation.
       auto menu = new QMenu();
       menu->addAction("What Is This?", [=]() {
-        // TODO: Handle this in a static method of ProgramReductionItem.
-        QString reductionHtml = ProgramReductionItem::simplifyMkRdxSource(
-          replicodeObjects_.getSourceCode(object)).c_str();
-        AeraGraphicsItem::addSourceCodeHtmlLinks(object, reductionHtml, replicodeObjects_);
-        reductionHtml = AeraGraphicsItem::htmlify(reductionHtml);
+        QString reductionHtml = ProgramReductionItem::getMkRdxHtml(object, replicodeObjects_);
 
         string explanation = "<b>Q: What is program reduction " + replicodeObjects_.getLabel(object) +
           "?</b><br>This the notification of a reduction of instantiated program <b>" + 
@@ -166,11 +164,9 @@ void ExplanationLogWindow::textBrowserAnchorClicked(const QUrl& url)
   }
 }
 
-void ExplanationLogWindow::TextBrowser::mouseMoveEvent(QMouseEvent* event)
+void ExplanationLogWindow::textBrowserHighlighted(const QUrl& url)
 {
-  parent_->mainWindow_->textItemHoverMoveEvent(document(), event->pos());
-
-  QTextBrowser::mouseMoveEvent(event);
+  mainWindow_->textItemHoverMoveEvent(url.url());
 }
 
 }
@@ -85,28 +85,12 @@ public:
 
 private slots:
   void textBrowserAnchorClicked(const QUrl& url);
+  void textBrowserHighlighted(const QUrl& url);
 
 private:
-  /**
-   * ExplanationLogWindow::TextBrowser extends QTextBrowser so that we can override its
-   * mouseMoveEvent.
-   */
-  class TextBrowser : public QTextBrowser {
-  public:
-    TextBrowser(ExplanationLogWindow* parent)
-      : QTextBrowser(parent), parent_(parent)
-    {}
-
-    ExplanationLogWindow* parent_;
-
-  protected:
-    void mouseMoveEvent(QMouseEvent* event) override;
-  };
-  friend TextBrowser;
-
   // TODO: We should be able to use textBrowser_ to append HTML.
   QString html_;
-  TextBrowser* textBrowser_;
+  QTextBrowser* textBrowser_;
 };
 
 }
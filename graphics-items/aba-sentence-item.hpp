@@ -73,12 +73,15 @@ public:
     AeraVisualizerScene* parent);
 
   void setStatus(ProcessStatus status) {
+    status_ = status;
     if (status == STATUS_DONE)
       statusTextItem_->setHtml(CheckMarkHtml);
     else
       statusTextItem_->setHtml(HourglassHtml);
   }
 
+  ProcessStatus getStatus() const { return status_; }
+
   bool isBetweenProponentAndOpponent(AeraGraphicsItem* other) {
     if (other->getAeraEvent()->eventType_ == AbaAddSentence::EVENT_TYPE) {
       auto otherEvent = (AbaAddSentence*)other->getAeraEvent();
@@ -117,6 +120,7 @@ protected:
 private:
   AbaAddSentence* addEvent_;
   QGraphicsTextItem* statusTextItem_;
+  ProcessStatus status_;
 };
 
 }
@@ -78,9 +78,14 @@ AeraGraphicsItemGroup::AeraGraphicsItemGroup(AeraVisualizerScene* parent, const
 void AeraGraphicsItemGroup::addChild(AeraGraphicsItem* child)
 {
   children_.insert(child);
-  fitToChildren();
-  if (child->isVisible())
+  if (child->isVisible()) {
+    if (childrenRect_.width() == 0)
+      childrenRect_ = child->sceneBoundingRect();
+    else
+      childrenRect_ = childrenRect_.united(child->sceneBoundingRect());
+    setRectFromChildrenRect();
     setVisible(true);
+  }
 
   qreal maybeNextTop = child->getAeraEvent()->itemTopLeftPosition_.y() + child->boundingRect().height() + 15;
   if (qIsNaN(nextTop_) || maybeNextTop > nextTop_)
@@ -122,6 +127,8 @@ QVariant AeraGraphicsItemGroup::itemChange(GraphicsItemChange change, const QVar
     QPointF newToPoint(pos().x(), value.toPointF().y());
     qreal deltaY = newToPoint.y() - pos().y();
     nextTop_ += deltaY;
+    parent_->updateGroupsMaxNextTop(nextTop_);
+    childrenRect_.translate(0, deltaY);
 
     for (auto child = children_.begin(); child != children_.end(); ++child) {
       // Deselect so that it doesn't move with the parent.
@@ -145,26 +152,32 @@ void AeraGraphicsItemGroup::fitToChildren()
   if (inCallback_)
     return;
  
-  inCallback_ = true;
-  QRectF childrenRect;
+  childrenRect_ = QRectF();
   for (auto child = children_.begin(); child != children_.end(); ++child) {
     if ((*child)->isVisible()) {
-      if (childrenRect.width() == 0)
-        childrenRect = (*child)->sceneBoundingRect();
+      if (childrenRect_.width() == 0)
+        childrenRect_ = (*child)->sceneBoundingRect();
       else
-        childrenRect = childrenRect.united((*child)->sceneBoundingRect());
+        childrenRect_ = childrenRect_.united((*child)->sceneBoundingRect());
     }
   }
 
+  setRectFromChildrenRect();
+}
+
+void AeraGraphicsItemGroup::setRectFromChildrenRect()
+{
   const qreal leftMargin = 27;
   const qreal rightMargin = 7;
   const qreal topMargin = 7;
   const qreal bottomMargin = 7;
-  if (childrenRect.width() != 0) {
-    setPos(childrenRect.left() - leftMargin, childrenRect.top() - topMargin);
-    setRect(0, 0, childrenRect.width() + leftMargin + rightMargin, childrenRect.height() + topMargin + bottomMargin);
+  if (childrenRect_.width() != 0) {
+    // Don't let itemChange move the children.
+    inCallback_ = true;
+    setPos(childrenRect_.left() - leftMargin, childrenRect_.top() - topMargin);
+    setRect(0, 0, childrenRect_.width() + leftMargin + rightMargin, childrenRect_.height() + topMargin + bottomMargin);
+    inCallback_ = false;
   }
-  inCallback_ = false;
 }
 
 }
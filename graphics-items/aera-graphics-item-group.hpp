@@ -82,10 +82,18 @@ public:
    */
   qreal getNextTop() { return nextTop_; }
 
+  /**
+   * Add the child and grow the group to include it. This only unites the child's bounds
+   * with the current bounds, so it does not visit the other children.
+   * \param child The AeraGraphicsItem, which should already be at its position.
+   */
   void addChild(AeraGraphicsItem* child);
 
   void removeChild(AeraGraphicsItem* child);
 
+  /**
+   * Recompute the bounds of the group from all its visible children.
+   */
   void fitToChildren();
 
   /**
@@ -106,8 +114,15 @@ private:
    */
   void setItemIsMovable();
 
+  /**
+   * Set the position and rect of the group from childrenRect_ plus the margins.
+   */
+  void setRectFromChildrenRect();
+
   AeraVisualizerScene* parent_;
   std::set<AeraGraphicsItem*> children_;
+  // The united sceneBoundingRect of the visible children, kept by addChild and fitToChildren.
+  QRectF childrenRect_;
   qreal nextTop_;
   bool inCallback_;
 };
@@ -53,12 +53,10 @@
 //_/_/ 
 //_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 
-#include <regex>
 #include <algorithm>
 #include <QGraphicsSceneContextMenuEvent>
 #include <QMenu>
 #include <QtWidgets>
-#include <QRegularExpression>
 #include "submodules/AERA/r_exec/opcodes.h"
 #include "arrow.hpp"
 #include "anchored-horizontal-line.hpp"
@@ -117,6 +115,8 @@ const QColor AeraGraphicsItem::Color_opponent_ums_nonAsm(0xAA, 0xAA, 0xAA);
 const QColor AeraGraphicsItem::Color_opponent_ums_nonAsm_border(0xAA, 0xAA, 0xAA);
 const QColor AeraGraphicsItem::Color_opponent_ums_nonAsm_text(0x00, 0x00, 0x00);
 const QColor AeraGraphicsItem::Color_attack_edge(0xBB, 0x22, 0x22);
+const qreal AeraGraphicsItem::LabelLevelOfDetail = 0.4;
+const qreal AeraGraphicsItem::RectangleLevelOfDetail = 0.15;
 
 AeraGraphicsItem::AeraGraphicsItem(
   AeraEvent* aeraEvent, ReplicodeObjects& replicodeObjects, AeraVisualizerScene* parent,
@@ -128,7 +128,10 @@ AeraGraphicsItem::AeraGraphicsItem(
   // The base class should call setTextItemAndPolygon()
   textItem_(0),
   horizontalLine_(0),
-  borderNoHighlightPen_(Qt::black, 1)
+  borderNoHighlightPen_(Qt::black, 1),
+  // A new item in the main scene starts as a shell. The scene rehydrates it when it is near the viewport.
+  isDehydrated_(parent->isMainScene()),
+  dehydratedTextWidth_(-1)
 {
   setBrush(is_sim() ? SimulatedItemColor : DefaultItemColor);
   setFlag(QGraphicsItem::ItemIsMovable, true);
@@ -139,7 +142,7 @@ AeraGraphicsItem::AeraGraphicsItem(
   Timestamp eventTime;
   if (is_sim())
     // We know that a simulated item's object has the form (fact (goal_or_pred (fact ...)))
-    eventTime = ((_Fact*)aeraEvent->object_->get_reference(0)->get_reference(0))->get_after();
+    eventTime = aeraEvent_->targetAfter_;
   else
     eventTime = aeraEvent_->time_;
   headerHtml_ = QString("<table width=\"100%\"><tr>") + 
@@ -147,36 +150,37 @@ AeraGraphicsItem::AeraGraphicsItem(
     "</font> <a href=\"#this\">" + replicodeObjects_.getLabel(aeraEvent_->object_).c_str() + "</a></b></font></td>" +
     "<td style=\"white-space:nowrap\" align=\"right\"><font style=\"color:gray\"> " + 
     replicodeObjects_.relativeTime(eventTime).c_str() + "</font></td>" + "</tr></table><br>";
+
+  label_.setTextFormat(Qt::PlainText);
+  label_.setText(headerPrefix + " " + replicodeObjects_.getLabel(aeraEvent_->object_).c_str());
+}
+
+/**
+ * Get the QTextDocument which setTextItemAndPolygon uses to measure the text of a dehydrated item
+ * without creating its textItem_. This is never deleted, since it must outlive the last item.
+ */
+static QTextDocument* getMeasureDocument()
+{
+  static QTextDocument* document = new QTextDocument();
+  return document;
 }
 
 void AeraGraphicsItem::setTextItemAndPolygon(QString html, bool prependHeaderHtml, Shape shape, qreal targetWidth)
 {
-  // Set up the textItem_ first to get its size.
-  if (textItem_)
-    delete textItem_;
-  textItem_ = new TextItem(this);
-  textItem_->setDefaultTextColor(textItemTextColor_);
-  textItem_->setHtml(html);
-  // adjustSize() is needed for right-aligned text.
-  textItem_->adjustSize();
-  if (prependHeaderHtml) {
-    // Now add headerHtml_ which has a right-aligned table cell.
-    textItem_->setHtml(headerHtml_ + html);
-    textItem_->adjustSize();
-  }
+  // adjustSize() lays out the text at its own trial widths before it sets the ideal width, so the
+  // right-aligned cell of headerHtml_ gets the width of the text in one pass.
+  // Set up the text first to get its size.
+  QSizeF textSize = setTextHtml(prependHeaderHtml ? headerHtml_ + html : html);
 
-  qreal left = -textItem_->boundingRect().width() / 2 - 5;
-  qreal top = -textItem_->boundingRect().height() / 2 - 5;
-  textItem_->setPos(left + 5, top + 5);
-  textItem_->setTextInteractionFlags(Qt::TextBrowserInteraction);
-  QObject::connect(textItem_, &QGraphicsTextItem::linkActivated,
-    [this](const QString& link) { textItemLinkActivated(link); });
+  qreal left = -textSize.width() / 2 - 5;
+  qreal top = -textSize.height() / 2 - 5;
+  setTextPos(QPointF(left + 5, top + 5));
 
-  qreal width = (textItem_->boundingRect().width() / 2 + 15) - left;
+  qreal width = (textSize.width() / 2 + 15) - left;
   if (targetWidth > width)
     width = targetWidth;
   qreal right = left + width;
-  qreal bottom = textItem_->boundingRect().height() / 2 + 5;
+  qreal bottom = textSize.height() / 2 + 5;
   const qreal diameter = 20;
 
   QPainterPath path;
@@ -218,7 +222,39 @@ void AeraGraphicsItem::setTextItemAndPolygon(QString html, bool prependHeaderHtm
     // We are resizing. Preserve the location of the top-left.
     auto delta = boundingRect().topLeft() - saveRect.topLeft();
     setPos(pos() - delta);
+    // setPos only updates the arrows if the position changed, but the size changed.
+    updateArrowsAndLine();
+  }
+}
+
+QSizeF AeraGraphicsItem::setTextHtml(const QString& html)
+{
+  if (isDehydrated_) {
+    // Measure the text the same as textItem_ below, but only save the HTML for rehydrate().
+    auto document = getMeasureDocument();
+    document->setHtml(html);
+    document->adjustSize();
+
+    dehydratedHtml_ = html;
+    dehydratedTextWidth_ = document->textWidth();
+    return document->size();
   }
+
+  if (textItem_)
+    delete textItem_;
+  textItem_ = new TextItem(this);
+  textItem_->setDefaultTextColor(textItemTextColor_);
+  textItem_->setHtml(html);
+  textItem_->adjustSize();
+  return textItem_->boundingRect().size();
+}
+
+void AeraGraphicsItem::setTextPos(const QPointF& pos)
+{
+  if (isDehydrated_)
+    dehydratedTextPos_ = pos;
+  else
+    textItem_->setPos(pos);
 }
 
 void AeraGraphicsItem::removeAndDeleteArrow(Arrow* arrow)
@@ -233,8 +269,7 @@ void AeraGraphicsItem::removeAndDeleteArrow(Arrow* arrow)
   auto endItem = dynamic_cast<AeraGraphicsItem*>(arrow->endItem());
   if (endItem)
     endItem->arrows_.removeAll(arrow);
-  scene()->removeItem(arrow);
-  delete arrow;
+  parent_->recycleArrow(arrow);
 }
 
 void AeraGraphicsItem::removeAndDeleteArrowToObject(Code* object)
@@ -252,17 +287,98 @@ void AeraGraphicsItem::removeArrowsAndHorizontalLine()
     removeAndDeleteArrow(arrow);
 
   if (horizontalLine_) {
-    scene()->removeItem(horizontalLine_);
-    delete horizontalLine_;
+    parent_->recycleHorizontalLine(horizontalLine_);
     horizontalLine_ = 0;
   }
 }
 
-void AeraGraphicsItem::setHorizontalLine(AnchoredHorizontalLine* line) {
+void AeraGraphicsItem::detachArrowsAndHorizontalLine()
+{
+  foreach(Arrow* arrow, arrows_) {
+    auto otherItem = dynamic_cast<AeraGraphicsItem*>(arrow->startItem() == this ? arrow->endItem() : arrow->startItem());
+    if (otherItem)
+      otherItem->arrows_.removeAll(arrow);
+    if (arrow->scene())
+      arrow->scene()->removeItem(arrow);
+  }
+
+  if (horizontalLine_ && horizontalLine_->scene())
+    horizontalLine_->scene()->removeItem(horizontalLine_);
+}
+
+void AeraGraphicsItem::reattachArrowsAndHorizontalLine()
+{
+  foreach(Arrow* arrow, arrows_) {
+    auto otherItem = dynamic_cast<AeraGraphicsItem*>(arrow->startItem() == this ? arrow->endItem() : arrow->startItem());
+    if (otherItem)
+      otherItem->arrows_.append(arrow);
+    parent_->addItem(arrow);
+    arrow->setVisible(isVisible() && otherItem && otherItem->isVisible());
+    arrow->updatePosition();
+  }
+
   if (horizontalLine_) {
-    scene()->removeItem(horizontalLine_);
-    delete horizontalLine_;
+    parent_->addItem(horizontalLine_);
+    horizontalLine_->updatePosition();
+  }
+}
+
+void AeraGraphicsItem::dehydrate()
+{
+  if (isDehydrated_)
+    return;
+  isDehydrated_ = true;
+
+  foreach(Arrow* arrow, arrows_) {
+    auto otherItem = dynamic_cast<AeraGraphicsItem*>(arrow->startItem() == this ? arrow->endItem() : arrow->startItem());
+    // Keep an arrow to an item in the scene so that it still points toward this item.
+    if (otherItem && otherItem->isDehydrated_ && arrow->scene())
+      arrow->scene()->removeItem(arrow);
   }
+
+  if (horizontalLine_ && horizontalLine_->scene())
+    horizontalLine_->scene()->removeItem(horizontalLine_);
+
+  if (textItem_) {
+    dehydratedHtml_ = textItem_->toHtml();
+    dehydratedTextWidth_ = textItem_->textWidth();
+    dehydratedTextPos_ = textItem_->pos();
+    delete textItem_;
+    textItem_ = 0;
+  }
+}
+
+void AeraGraphicsItem::rehydrate()
+{
+  if (!isDehydrated_)
+    return;
+  isDehydrated_ = false;
+
+  if (!dehydratedHtml_.isNull()) {
+    textItem_ = new TextItem(this);
+    textItem_->setDefaultTextColor(textItemTextColor_);
+    textItem_->setHtml(dehydratedHtml_);
+    textItem_->setTextWidth(dehydratedTextWidth_);
+    textItem_->setPos(dehydratedTextPos_);
+    dehydratedHtml_ = QString();
+  }
+
+  foreach(Arrow* arrow, arrows_) {
+    if (!arrow->scene()) {
+      parent_->addItem(arrow);
+      arrow->updatePosition();
+    }
+  }
+
+  if (horizontalLine_ && !horizontalLine_->scene()) {
+    parent_->addItem(horizontalLine_);
+    horizontalLine_->updatePosition();
+  }
+}
+
+void AeraGraphicsItem::setHorizontalLine(AnchoredHorizontalLine* line) {
+  if (horizontalLine_)
+    parent_->recycleHorizontalLine(horizontalLine_);
   horizontalLine_ = line;
 }
 
@@ -360,37 +476,16 @@ QVariant AeraGraphicsItem::itemChange(GraphicsItemChange change, const QVariant&
 
     updateArrowsAndLine();
   }
+  else if (change == QGraphicsItem::ItemPositionHasChanged ||
+           change == QGraphicsItem::ItemVisibleHasChanged)
+    parent_->updateSkyline(this);
 
   return value;
 }
 
 QString AeraGraphicsItem::htmlify(const QString& input, bool useNowrap)
 {
-  QString result = input;
-
-  int maxExtraSpaces = 0;
-  QRegularExpression extraSpaceRegex(" ( +)");
-  for (auto i = extraSpaceRegex.globalMatch(result); i.hasNext(); ) {
-    auto match = i.next();
-    maxExtraSpaces = max(maxExtraSpaces, match.captured(1).size());
-  }
-
-  // Start with the most extra spaces and work backwards.
-  for (int extraSpaces = maxExtraSpaces; extraSpaces >= 1; --extraSpaces) {
-    QString find = " ";
-    QString replace = " ";
-    for (int i = 0; i <= extraSpaces; ++i) {
-      find += " ";
-      replace += "&nbsp;";
-    }
-    
-    result.replace(find, replace);
-  }
-
-  result.replace("|fact", "<b><font color=\"#ff4040\">|fact</font></b>");
-  result.replace("|pgm", "<b><font color=\"#ff4040\">|pgm</font></b>");
-  result.replace("\n", "<br>");
-  result.replace("\x01", "<br>");
+  QString result = annotateSourceCode(input, QHash<QString, QString>(), true);
 
   if (useNowrap)
     result = "<div style=\"white-space: nowrap;\">" + result + "</div>";
@@ -410,9 +505,10 @@ QString AeraGraphicsItem::makeHtmlLink(
     label + "</a>";
 }
 
-void AeraGraphicsItem::addSourceCodeHtmlLinks(
-  Code* object, QString& html, const ReplicodeObjects& replicodeObjects)
+QHash<QString, QString> AeraGraphicsItem::getSourceCodeHtmlLinks(
+  Code* object, const ReplicodeObjects& replicodeObjects)
 {
+  QHash<QString, QString> labelLinks;
   for (int i = 0; i < object->references_size(); ++i) {
     auto referencedObject = object->get_reference(i);
     if (!(referencedObject->code(0).asOpcode() == Opcodes::Mdl ||
@@ -423,41 +519,125 @@ void AeraGraphicsItem::addSourceCodeHtmlLinks(
       continue;
 
     QString referencedLabel(replicodeObjects.getLabel(referencedObject).c_str());
-    if (referencedLabel == "")
+    if (referencedLabel == "" || labelLinks.contains(referencedLabel))
       continue;
 
-    // TODO: Handle case when the label is not surrounded by spaces.
-    html.replace(
-      " " + referencedLabel + " ",
-      " " + makeHtmlLink(referencedObject, replicodeObjects) + " ");
-    // The same for at the end of a line.
-    html.replace(
-      " " + referencedLabel + "<br>",
-      " " + makeHtmlLink(referencedObject, replicodeObjects) + "<br>");
-    // The same for at the end of an object.
-    html.replace(
-      " " + referencedLabel + ")",
-      " " + makeHtmlLink(referencedObject, replicodeObjects) + ")");
-    // The same for at the beginning of a list.
-    html.replace(
-      "[" + referencedLabel + " ",
-      "[" + makeHtmlLink(referencedObject, replicodeObjects) + " ");
-    // The same for at the end of a list.
-    html.replace(
-      " " + referencedLabel + "]",
-      " " + makeHtmlLink(referencedObject, replicodeObjects) + "]");
-    // The same for at the only one in a list.
-    html.replace(
-      "[" + referencedLabel + "]",
-      "[" + makeHtmlLink(referencedObject, replicodeObjects) + "]");
+    labelLinks[referencedLabel] = makeHtmlLink(referencedObject, replicodeObjects);
   }
+
+  return labelLinks;
+}
+
+// Return true if c can be part of a label such as "mdl_74" or a number such as "0.5".
+static bool isLabelChar(QChar c)
+{
+  ushort u = c.unicode();
+  return (u >= 'a' && u <= 'z') || (u >= 'A' && u <= 'Z') || (u >= '0' && u <= '9') ||
+    u == '_' || u == '.';
+}
+
+QString AeraGraphicsItem::annotateSourceCode(
+  const QString& input, const QHash<QString, QString>& labelLinks, bool useHtmlify)
+{
+  static const QString antiFactHtml = "<b><font color=\"#ff4040\">|fact</font></b>";
+  static const QString antiProgramHtml = "<b><font color=\"#ff4040\">|pgm</font></b>";
+  static const QString nbspHtml = "&nbsp;";
+  static const QString brHtml = "<br>";
+
+  QString result;
+  result.reserve(input.size() + input.size() / 2);
+  const QChar* data = input.constData();
+  const int size = input.size();
+  bool inLink = false;
+
+  int i = 0;
+  while (i < size) {
+    QChar c = data[i];
+    if (c == '<' && i + 1 < size && (data[i + 1].isLetter() || data[i + 1] == '/')) {
+      // Copy an HTML tag as is. (A Replicode operator like "<" or "<=" is not followed by a letter.)
+      int end = input.indexOf('>', i);
+      end = (end < 0 ? size : end + 1);
+      QStringRef tag = input.midRef(i, end - i);
+      if (tag.startsWith("<a ") || tag == "<a>")
+        inLink = true;
+      else if (tag == "</a>")
+        inLink = false;
+      result += tag;
+      i = end;
+    }
+    else if (isLabelChar(c)) {
+      int end = i + 1;
+      while (end < size && isLabelChar(data[end]))
+        ++end;
+
+      auto link = labelLinks.constEnd();
+      if (!inLink && !labelLinks.isEmpty())
+        // fromRawData doesn't copy the characters.
+        link = labelLinks.constFind(QString::fromRawData(data + i, end - i));
+      if (link != labelLinks.constEnd())
+        result += *link;
+      else
+        result.append(data + i, end - i);
+      i = end;
+    }
+    else if (useHtmlify && c == ' ') {
+      int end = i + 1;
+      while (end < size && data[end] == ' ')
+        ++end;
+
+      int nSpaces = end - i;
+      if (nSpaces >= 3) {
+        // Keep the first space so that the text can wrap there.
+        result += ' ';
+        for (int j = 1; j < nSpaces; ++j)
+          result += nbspHtml;
+      }
+      else
+        result.append(data + i, nSpaces);
+      i = end;
+    }
+    else if (useHtmlify && c == '|' && input.midRef(i, 5) == "|fact") {
+      result += antiFactHtml;
+      i += 5;
+    }
+    else if (useHtmlify && c == '|' && input.midRef(i, 4) == "|pgm") {
+      result += antiProgramHtml;
+      i += 4;
+    }
+    else if (useHtmlify && (c == '\n' || c == '\x01')) {
+      result += brHtml;
+      ++i;
+    }
+    else {
+      result += c;
+      ++i;
+    }
+  }
+
+  return result;
+}
+
+void AeraGraphicsItem::addSourceCodeHtmlLinks(
+  Code* object, QString& html, const ReplicodeObjects& replicodeObjects)
+{
+  html = annotateSourceCode(html, getSourceCodeHtmlLinks(object, replicodeObjects), false);
+}
+
+QString AeraGraphicsItem::htmlifyWithLinks(
+  Code* object, const QString& source, const ReplicodeObjects& replicodeObjects, bool useNowrap)
+{
+  QString result = annotateSourceCode(source, getSourceCodeHtmlLinks(object, replicodeObjects), true);
+
+  if (useNowrap)
+    result = "<div style=\"white-space: nowrap;\">" + result + "</div>";
+
+  return result;
 }
 
 void AeraGraphicsItem::setItemAndArrowsAndHorizontalLineVisible(bool visible)
 {
   foreach(Arrow* arrow, arrows_) {
     if (visible) {
-      adjustItemYPosition();
       // Only set the arrow visible if the connected item is visible.
       if (arrow->startItem() == this && arrow->endItem()->isVisible() ||
           arrow->endItem() == this && arrow->startItem()->isVisible())
@@ -473,6 +653,12 @@ void AeraGraphicsItem::setItemAndArrowsAndHorizontalLineVisible(bool visible)
     horizontalLine_->setVisible(visible);
   
   setVisible(visible);
+  if (visible && arrows_.size() > 0)
+    // Items which were hidden are not in the skyline, so this item may now collide with one.
+    adjustItemYPosition();
+  if (visible)
+    // A hidden item may be a shell which has not made its text yet.
+    parent_->rehydrateIfNearViewport(this);
 }
 
 void aera_visualizer::AeraGraphicsItem::adjustItemYPosition()
@@ -486,60 +672,24 @@ void aera_visualizer::AeraGraphicsItem::adjustItemYPosition()
     return;
   }
   // Margin between two items
-  float margin = 15;
-  // Lowest edge of all colliding items - this is under which we want to move the current item
-  float max_y_border = 0;
-  auto time = std::chrono::duration_cast<std::chrono::microseconds>(getAeraEvent()->time_ - replicodeObjects_.getTimeReference());
-  auto frame_time = getAeraEvent()->time_ - (time % replicodeObjects_.getSamplingPeriod());
-  while (true) {
-    for (auto it : collidingItems()) {
-      // Check whether the colliding item is an AeraGraphicsItem.
-      auto valid_item = dynamic_cast<AeraGraphicsItem*>(it);
-      if (!valid_item) {
-        continue;
-      }
-      if (valid_item->getAeraEvent()->itemInitialTopLeftPosition_ != valid_item->getAeraEvent()->itemTopLeftPosition_) {
-        continue;
-      }
-      // We do not care for sim-items
-      if (AeraVisualizerWindow::simulationEventTypes_.find(valid_item->getAeraEvent()->eventType_) !=
-        AeraVisualizerWindow::simulationEventTypes_.end()) {
-        continue;
-      }
-      // If the colliding item comes from a different time-stamp we do not want to adjust the position.
-      auto relative_time = std::chrono::duration_cast<std::chrono::microseconds>
-        (valid_item->getAeraEvent()->time_ - replicodeObjects_.getTimeReference());
-      auto valid_item_frame_time = valid_item->getAeraEvent()->time_ - (relative_time % replicodeObjects_.getSamplingPeriod());
-      if (valid_item_frame_time != frame_time) {
-        continue;
-      }
-      // Gets the y-position of the bottom edge of the collding item
-      float bottom_border = valid_item->pos().y() + valid_item->boundingRect().height() / 2;
-      if (max_y_border < bottom_border) {
-        max_y_border = bottom_border;
-      }
-    }
-    if (max_y_border < (pos().y() - boundingRect().height() / 2)) {
-      return;
-    }
+  qreal margin = 15;
+  // Take this item out of the skyline of its frame so that it doesn't collide with itself.
+  parent_->removeFromSkyline(this);
+  qreal top = sceneBoundingRect().top();
+  qreal freeTop = parent_->getSkylineFreeTop(this, top, margin);
+  if (freeTop != top) {
     // Move the current item below the lowest colliding item
-    setPos(QPointF(pos().x(), max_y_border + margin + boundingRect().height() / 2));
+    setPos(pos() + QPointF(0, freeTop - top));
     getAeraEvent()->itemInitialTopLeftPosition_ = getAeraEvent()->itemTopLeftPosition_;
   }
+  parent_->updateSkyline(this);
 }
 
-bool AeraGraphicsItem::is_sim()
+void AeraGraphicsItem::setBorderFlashCountdown(int countdown)
 {
-  if (!aeraEvent_->object_ || aeraEvent_->object_->references_size() < 1)
-    return false;
-
-  auto obj = aeraEvent_->object_->get_reference(0);
-  if (obj->code(0).asOpcode() == Opcodes::Goal)
-    return ((Goal*)obj)->is_simulation();
-  else if (obj->code(0).asOpcode() == Opcodes::Pred)
-    return ((Pred*)obj)->is_simulation();
-
-  return false;
+  borderFlashCountdown_ = countdown;
+  if (countdown > 0)
+    parent_->addFlashingItem(this);
 }
 
 void AeraGraphicsItem::textItemLinkActivated(const QString& link)
@@ -614,35 +764,368 @@ void AeraGraphicsItem::mousePressEvent(QGraphicsSceneMouseEvent* mouseEvent)
   QGraphicsItem::mousePressEvent(mouseEvent);
 }
 
+void AeraGraphicsItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
+{
+  qreal levelOfDetail = QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform());
+  if (levelOfDetail >= LabelLevelOfDetail) {
+    QGraphicsPolygonItem::paint(painter, option, widget);
+    return;
+  }
+
+  QRectF rect = polygon().boundingRect();
+  if (levelOfDetail < RectangleLevelOfDetail) {
+    // The item is only a few pixels, so the shape and label don't matter.
+    painter->fillRect(rect, brush());
+    return;
+  }
+
+  painter->setPen(pen());
+  painter->setBrush(brush());
+  painter->drawPolygon(polygon());
+
+  // Scale the label to a readable size on the screen, but keep it inside the item.
+  qreal margin = 5;
+  qreal availableWidth = rect.width() - 2 * margin;
+  qreal labelWidth = label_.size().width();
+  if (availableWidth <= 0 || labelWidth <= 0)
+    return;
+  qreal scale = min(1 / levelOfDetail, availableWidth / labelWidth);
+  painter->save();
+  painter->setPen(textItemTextColor_);
+  painter->translate(rect.left() + margin, rect.top() + margin);
+  painter->scale(scale, scale);
+  painter->drawStaticText(0, 0, label_);
+  painter->restore();
+}
+
+AeraGraphicsItem::TextItem::TextItem(AeraGraphicsItem* parent)
+: QGraphicsItem(parent),
+  parent_(parent),
+  defaultTextColor_(Qt::black),
+  linkRectsAreSet_(false)
+{
+  document_.setUndoRedoEnabled(false);
+  setAcceptHoverEvents(true);
+  // Get key events for copying the selection.
+  setFlag(QGraphicsItem::ItemIsFocusable, true);
+  setCursor(Qt::IBeamCursor);
+  setCacheMode(QGraphicsItem::DeviceCoordinateCache);
+}
+
+void AeraGraphicsItem::TextItem::setHtml(const QString& html)
+{
+  beginLayoutChange();
+  // The old selection positions don't apply to the new text.
+  selection_ = QTextCursor();
+  document_.setHtml(html);
+}
+
+void AeraGraphicsItem::TextItem::setTextWidth(qreal width)
+{
+  beginLayoutChange();
+  document_.setTextWidth(width);
+}
+
+void AeraGraphicsItem::TextItem::adjustSize()
+{
+  beginLayoutChange();
+  document_.adjustSize();
+}
+
+void AeraGraphicsItem::TextItem::setDefaultTextColor(const QColor& color)
+{
+  defaultTextColor_ = color;
+  update();
+}
+
+void AeraGraphicsItem::TextItem::beginLayoutChange()
+{
+  prepareGeometryChange();
+  linkRectsAreSet_ = false;
+  html_ = QString();
+  // The link may move, so check it again at the next hoverMoveEvent.
+  clearHoveredLink();
+}
+
+void AeraGraphicsItem::TextItem::clearHoveredLink()
+{
+  if (hoveredLink_ == "")
+    return;
+  hoveredLink_ = "";
+
+  parent_->parent_->getParent()->textItemHoverMoveEvent("");
+  setCursor(Qt::IBeamCursor);
+  parent_->setToolTip("");
+}
+
+QRectF AeraGraphicsItem::TextItem::boundingRect() const
+{
+  return QRectF(QPointF(0, 0), document_.size());
+}
+
+void AeraGraphicsItem::TextItem::setLinkRects()
+{
+  linkRects_.clear();
+  auto documentLayout = document_.documentLayout();
+  for (auto block = document_.begin(); block.isValid(); block = block.next()) {
+    auto layout = block.layout();
+    // The line positions are relative to the top-left of the block.
+    QPointF blockTopLeft = documentLayout->blockBoundingRect(block).topLeft();
+
+    for (auto fragment = block.begin(); !fragment.atEnd(); ++fragment) {
+      QTextCharFormat format = fragment.fragment().charFormat();
+      if (!format.isAnchor() || format.anchorHref().isEmpty())
+        continue;
+
+      int start = fragment.fragment().position() - block.position();
+      int end = start + fragment.fragment().length();
+      for (int i = 0; i < layout->lineCount(); ++i) {
+        QTextLine line = layout->lineAt(i);
+        int lineStart = max(start, line.textStart());
+        int lineEnd = min(end, line.textStart() + line.textLength());
+        if (lineStart >= lineEnd)
+          continue;
+
+        qreal left = line.cursorToX(lineStart);
+        qreal right = line.cursorToX(lineEnd);
+        linkRects_.push_back(make_pair(
+          QRectF(blockTopLeft.x() + min(left, right), blockTopLeft.y() + line.y(), qAbs(right - left), line.height()),
+          format.anchorHref()));
+      }
+    }
+  }
+
+  linkRectsAreSet_ = true;
+}
+
+QString AeraGraphicsItem::TextItem::anchorAt(const QPointF& position)
+{
+  if (!linkRectsAreSet_)
+    setLinkRects();
+
+  for (auto linkRect = linkRects_.begin(); linkRect != linkRects_.end(); ++linkRect) {
+    if (linkRect->first.contains(position))
+      return linkRect->second;
+  }
+
+  return "";
+}
+
+bool AeraGraphicsItem::TextItem::replaceLinesToEndOfBlock(
+  const QString& findText, const vector<pair<QString, QColor> >& lines)
+{
+  QTextCursor cursor = document_.find(findText);
+  if (cursor.isNull())
+    return false;
+
+  QTextBlock block = cursor.block();
+  int lineStart = block.text().lastIndexOf(QChar::LineSeparator, cursor.selectionStart() - block.position());
+  lineStart = (lineStart < 0 ? 0 : lineStart + 1);
+
+  QTextCharFormat format = cursor.charFormat();
+  QFontMetricsF metrics(format.font());
+  // The width of the line is the width available in the block.
+  qreal availableWidth = block.layout()->lineAt(0).width();
+  for (auto line = lines.begin(); line != lines.end(); ++line) {
+    if (metrics.horizontalAdvance(line->first) > availableWidth)
+      return false;
+  }
+
+  html_ = QString();
+  cursor.setPosition(block.position() + lineStart);
+  cursor.movePosition(QTextCursor::EndOfBlock, QTextCursor::KeepAnchor);
+  cursor.removeSelectedText();
+  for (size_t i = 0; i < lines.size(); ++i) {
+    if (i > 0)
+      cursor.insertText(QString(QChar::LineSeparator));
+    format.setForeground(lines[i].second);
+    cursor.insertText(lines[i].first, format);
+  }
+
+  linkRectsAreSet_ = false;
+  // Only repaint the block in the cached pixmap.
+  update(document_.documentLayout()->blockBoundingRect(block));
+  return true;
+}
+
+void AeraGraphicsItem::TextItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
+{
+  if (QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform()) <
+      AeraGraphicsItem::LabelLevelOfDetail)
+    // The parent paints its label instead.
+    return;
+
+  QAbstractTextDocumentLayout::PaintContext context;
+  context.palette.setColor(QPalette::Text, defaultTextColor_);
+  context.clip = option->exposedRect;
+  if (selection_.hasSelection()) {
+    QAbstractTextDocumentLayout::Selection selection;
+    selection.cursor = selection_;
+    selection.format.setBackground(option->palette.brush(QPalette::Highlight));
+    selection.format.setForeground(option->palette.brush(QPalette::HighlightedText));
+    context.selections.append(selection);
+  }
+  painter->save();
+  painter->setClipRect(option->exposedRect, Qt::IntersectClip);
+  document_.documentLayout()->draw(painter, context);
+  painter->restore();
+}
+
 void AeraGraphicsItem::TextItem::hoverMoveEvent(QGraphicsSceneHoverEvent* event)
 {
+  auto url = anchorAt(event->pos());
+  if (url == hoveredLink_)
+    // Still on the same link (or no link), so do nothing.
+    return;
+  hoveredLink_ = url;
+
   auto window = parent_->parent_->getParent();
-  window->textItemHoverMoveEvent(document(), event->pos());
+  window->textItemHoverMoveEvent(url);
+  setCursor(url == "" ? Qt::IBeamCursor : Qt::PointingHandCursor);
 
   // If we are hovering a linked item, show the linked item as tooltip
-  auto url = document()->documentLayout()->anchorAt(event->pos());
+  QString toolTip = "";
   if (url.startsWith("#detail_oid-")) {
     uint64 detail_oid = url.mid(12).toULongLong();
     auto object = parent_->replicodeObjects_.getObjectByDetailOid(detail_oid);
     if (object) {
       AeraGraphicsItem *aeraGraphicsItem = window->getAeraGraphicsItem(object);
-      if (aeraGraphicsItem) {
-        parent_->setToolTip(aeraGraphicsItem->getHtml());
-      }
+      if (aeraGraphicsItem)
+        toolTip = aeraGraphicsItem->getHtml();
     }
   }
-  else {
-    parent_->setToolTip("");
-  }
+  parent_->setToolTip(toolTip);
+}
 
-  QGraphicsTextItem::hoverMoveEvent(event);
+void AeraGraphicsItem::TextItem::hoverLeaveEvent(QGraphicsSceneHoverEvent* event)
+{
+  // Check the link again when the mouse cursor enters.
+  clearHoveredLink();
+  QGraphicsItem::hoverLeaveEvent(event);
 }
 
 void AeraGraphicsItem::TextItem::mousePressEvent(QGraphicsSceneMouseEvent* mouseEvent)
 {
   // Forward mouse click events to the graphics item itself
   parent_->mousePressEvent(mouseEvent);
-  QGraphicsTextItem::mousePressEvent(mouseEvent);
+  // Accept the press so that we get the move and release, like QGraphicsTextItem.
+  mouseEvent->accept();
+  if (mouseEvent->button() != Qt::LeftButton) {
+    pressedLink_ = "";
+    return;
+  }
+
+  pressedLink_ = anchorAt(mouseEvent->pos());
+  setFocus(Qt::MouseFocusReason);
+  QTextCursor selection = (selection_.isNull() ? QTextCursor(&document_) : selection_);
+  selection.setPosition(hitTest(mouseEvent->pos()),
+    (mouseEvent->modifiers() & Qt::ShiftModifier) ? QTextCursor::KeepAnchor : QTextCursor::MoveAnchor);
+  setSelection(selection);
+}
+
+void AeraGraphicsItem::TextItem::mouseMoveEvent(QGraphicsSceneMouseEvent* mouseEvent)
+{
+  if (!(mouseEvent->buttons() & Qt::LeftButton) || selection_.isNull())
+    return;
+
+  QTextCursor selection = selection_;
+  selection.setPosition(hitTest(mouseEvent->pos()), QTextCursor::KeepAnchor);
+  setSelection(selection);
+  if (selection_.hasSelection())
+    // Dragging to select text doesn't activate the link.
+    pressedLink_ = "";
+}
+
+void AeraGraphicsItem::TextItem::mouseDoubleClickEvent(QGraphicsSceneMouseEvent* mouseEvent)
+{
+  if (mouseEvent->button() != Qt::LeftButton) {
+    QGraphicsItem::mouseDoubleClickEvent(mouseEvent);
+    return;
+  }
+
+  mouseEvent->accept();
+  QTextCursor selection(&document_);
+  selection.setPosition(hitTest(mouseEvent->pos()));
+  selection.select(QTextCursor::WordUnderCursor);
+  setSelection(selection);
 }
 
+void AeraGraphicsItem::TextItem::keyPressEvent(QKeyEvent* event)
+{
+  if (event->matches(QKeySequence::Copy))
+    copySelection();
+  else if (event->matches(QKeySequence::SelectAll)) {
+    QTextCursor selection(&document_);
+    selection.select(QTextCursor::Document);
+    setSelection(selection);
+  }
+  else
+    event->ignore();
+}
+
+void AeraGraphicsItem::TextItem::focusOutEvent(QFocusEvent* event)
+{
+  if (event->reason() != Qt::PopupFocusReason)
+    // Only show the selection in the item which has focus.
+    setSelection(QTextCursor());
+  QGraphicsItem::focusOutEvent(event);
+}
+
+void AeraGraphicsItem::TextItem::contextMenuEvent(QGraphicsSceneContextMenuEvent* event)
+{
+  if (!selection_.hasSelection()) {
+    // Let the parent show its menu.
+    event->ignore();
+    return;
+  }
+
+  auto menu = new QMenu();
+  menu->addAction("Copy", [=]() { copySelection(); });
+  menu->exec(event->screenPos());
+  delete menu;
+}
+
+int AeraGraphicsItem::TextItem::hitTest(const QPointF& position) const
+{
+  int cursorPosition = document_.documentLayout()->hitTest(position, Qt::FuzzyHit);
+  return (cursorPosition < 0 ? 0 : cursorPosition);
+}
+
+void AeraGraphicsItem::TextItem::setSelection(const QTextCursor& selection)
+{
+  if (selection == selection_ && selection.anchor() == selection_.anchor())
+    return;
+
+  bool needsUpdate = (selection.hasSelection() || selection_.hasSelection());
+  selection_ = selection;
+  if (needsUpdate)
+    update();
+}
+
+void AeraGraphicsItem::TextItem::copySelection(QClipboard::Mode mode)
+{
+  if (!selection_.hasSelection())
+    return;
+
+  QString text = selection_.selection().toPlainText();
+  // Copy non-breaking spaces as plain spaces, like QTextControl.
+  text.replace(QChar::Nbsp, ' ');
+  QGuiApplication::clipboard()->setText(text, mode);
+}
+
+void AeraGraphicsItem::TextItem::mouseReleaseEvent(QGraphicsSceneMouseEvent* mouseEvent)
+{
+  if (mouseEvent->button() == Qt::LeftButton && QGuiApplication::clipboard()->supportsSelection())
+    // Like QTextControl, put the selected text in the X11 selection.
+    copySelection(QClipboard::Selection);
+
+  if (mouseEvent->button() != Qt::LeftButton || pressedLink_ == "")
+    return;
+
+  QString link = pressedLink_;
+  pressedLink_ = "";
+  if (anchorAt(mouseEvent->pos()) == link)
+    // This may replace the textItem_ and delete this TextItem, so return after.
+    parent_->textItemLinkActivated(link);
+}
 }
@@ -56,9 +56,15 @@
 #ifndef AERA_GRAPHICS_ITEM_HPP
 #define AERA_GRAPHICS_ITEM_HPP
 
+#include <vector>
 #include <QGraphicsPixmapItem>
 #include <QList>
+#include <QHash>
 #include <QPen>
+#include <QStaticText>
+#include <QClipboard>
+#include <QTextCursor>
+#include <QTextDocument>
 #include "../replicode-objects.hpp"
 #include "aera-event.hpp"
 
@@ -109,9 +115,10 @@ public:
   void addArrow(Arrow* arrow) { arrows_.append(arrow); }
 
   /**
-   * Remove the Arrow from the list of arrows, delete it from the scene and delete the arrow.
+   * Remove the Arrow from the list of arrows, remove it from the scene and give it to
+   * AeraVisualizerScene::recycleArrow so that the scene can reuse it.
    * \param arrow The Arrow to remove from the list of arrows. If it is not in the
-   * list, then do nothing (do not delete it or remove from the parent scene).
+   * list, then do nothing (do not recycle it or remove from the parent scene).
    */
   void removeAndDeleteArrow(Arrow* arrow);
 
@@ -126,10 +133,42 @@ public:
    * Remove all arrows and horizontal line and remove them from the parent scene.
    */
   void removeArrowsAndHorizontalLine();
+
+  /**
+   * Remove all arrows and the horizontal line from the parent scene without deleting them, and
+   * remove the arrows from the arrow list of the item at the other end. This item keeps them
+   * so that reattachArrowsAndHorizontalLine() can add them back. Call this before removing this
+   * item from the scene without deleting it.
+   */
+  void detachArrowsAndHorizontalLine();
+
+  /**
+   * Undo detachArrowsAndHorizontalLine(). Add the arrows and horizontal line back to the
+   * parent scene and add the arrows to the item at the other end. Call this after adding
+   * this item back to the scene.
+   */
+  void reattachArrowsAndHorizontalLine();
   void setHorizontalLine(AnchoredHorizontalLine* line);
   void updateArrowsAndLine();
   AeraEvent* getAeraEvent() { return aeraEvent_; }
-  QString getHtml() { return textItem_->toHtml(); }
+  QString getHtml() { return isDehydrated_ ? dehydratedHtml_ : textItem_->toHtml(); }
+
+  /**
+   * Release the textItem_ and its QTextDocument while the item is far from the viewport, saving
+   * its HTML for rehydrate(). Also remove the horizontal line and the arrows whose other item is
+   * dehydrated from the scene. The polygon, position and arrow list are kept. This is called by
+   * AeraVisualizerScene, which then removes this item from the scene.
+   */
+  void dehydrate();
+
+  /**
+   * Undo dehydrate(). Recreate the textItem_ from the saved HTML, and add the horizontal line
+   * and arrows back to the scene. This is called by AeraVisualizerScene after it adds this item
+   * back to the scene.
+   */
+  void rehydrate();
+
+  bool isDehydrated() const { return isDehydrated_; }
 
   /**
    * Change the Z value of this item to be slightly greater than other colliding AeraGraphicsItems.
@@ -153,7 +192,8 @@ public:
   void ensureVisible();
 
   /**
-   * Replace all "\n" or "\x01" with "<br>" and extra " " with "&nbsp;".
+   * Replace all "\n" or "\x01" with "<br>" and extra " " with "&nbsp;", and highlight
+   * "|fact" and "|pgm". This is one pass over the input.
    * \param input The input string to htmlify.
    * \param useNowrap (optional) If true, put the HTMl inside <div style="white-space: nowrap;">.
    * If omitted, use false.
@@ -196,6 +236,26 @@ public:
     addSourceCodeHtmlLinks(object, html, replicodeObjects_);
   }
 
+  /**
+   * Do the same as addSourceCodeHtmlLinks followed by htmlify, in one pass over the source.
+   * \param object The object with the references.
+   * \param source The source code string.
+   * \param replicodeObjects the ReplicodeObjects for looking up labels. This is passed
+   * as a param so that this can be a static method. If you have an AeraGraphicsItem object,
+   * you can call the htmlifyWithLinks member method.
+   * \param useNowrap (optional) If true, put the HTMl inside <div style="white-space: nowrap;">.
+   * If omitted, use false.
+   * \return The HTML string.
+   */
+  static QString htmlifyWithLinks(
+    r_code::Code* object, const QString& source, const ReplicodeObjects& replicodeObjects,
+    bool useNowrap = false);
+
+  QString htmlifyWithLinks(r_code::Code* object, const QString& source, bool useNowrap = false)
+  {
+    return htmlifyWithLinks(object, source, replicodeObjects_, useNowrap);
+  }
+
   /**
    * Set the the visible state of this item and the connected arrows and anchored horizontal line.
    * \param visible The visible state.
@@ -205,6 +265,7 @@ public:
   /**
    * Adjust the position of the item.
    It moves the item below the lowest item under which it fits without colliding with other items from this timeframe.
+   The other items are found in the scene's skyline for the frame, not by asking for colliding items.
    */
   void adjustItemYPosition();
 
@@ -213,15 +274,22 @@ public:
 
   /**
    * Check if getAeraEvent()->object_ is a simulated goal or prediction. This is meant
-   * to imitate the Replicode is_sim operator.
+   * to imitate the Replicode is_sim operator. This is precomputed by AeraEvent::setDerivedAttributes.
    * \return True if the object is simulated.
    */
-  bool is_sim();
+  bool is_sim() { return aeraEvent_->isSimulation_; }
 
   AeraVisualizerScene* getParentScene() {
     return parent_;
   }
 
+  /**
+   * Set borderFlashCountdown_. If it is positive, add this item to the flashing items of the
+   * parent scene so that the flash timer counts it down.
+   * \param countdown The new countdown, usually AeraVisualizerScene::FLASH_COUNT.
+   */
+  void setBorderFlashCountdown(int countdown);
+
   /* Helper functions to save/restore original pen when we need to highlight this item */
   void savePen() {
     if (borderFlashCountdown_ > 0) // Don't restore the highlight pen
@@ -279,29 +347,158 @@ public:
   static const QColor Color_opponent_ums_nonAsm_text;
   static const QColor Color_attack_edge;
 
+  // When the view scale is below this level of detail, paint the item as a filled shape with a
+  // short label instead of the text item.
+  static const qreal LabelLevelOfDetail;
+  // When the view scale is below this level of detail, paint the item as a filled rectangle only.
+  static const qreal RectangleLevelOfDetail;
+
+  // Use setBorderFlashCountdown to start a flash. This is only set directly before the item
+  // is added to the scene, which adds it to the flashing items if positive.
   int borderFlashCountdown_;
 
 protected:
   typedef enum { SHAPE_RECTANGLE, SHAPE_GOAL, SHAPE_PRED, SHAPE_STOP } Shape;
 
   /**
-   * AeraGraphicsItem::TextItem extends QGraphicsTextItem so that we can override its
-   * hoverMoveEvent.
+   * AeraGraphicsItem::TextItem shows the HTML of the item. Instead of a QGraphicsTextItem, which
+   * has a text control with a cursor, undo stack and signals, this only has a QTextDocument which
+   * is laid out once. The rectangles of the links are found when first needed, and a click on a
+   * link calls the parent's textItemLinkActivated. Like Qt::TextBrowserInteraction, the mouse
+   * selects text (drag, double-click for a word, shift-click to extend) and the keyboard can copy
+   * it and select all. The selection is a QTextCursor on the document_. The rendered text is
+   * cached in a device-coordinate pixmap, since it only changes when setTextItemAndPolygon
+   * replaces the TextItem or the selection changes. Highlight and flash pens are drawn by the
+   * parent AeraGraphicsItem, so they don't invalidate the cache.
    */
-  class TextItem : public QGraphicsTextItem {
+  class TextItem : public QGraphicsItem {
   public:
-    TextItem(AeraGraphicsItem* parent)
-      : QGraphicsTextItem(parent), parent_(parent)
-    {}
+    TextItem(AeraGraphicsItem* parent);
+
+    void setHtml(const QString& html);
+    /**
+     * Get the HTML of the document. This is cached until the text is changed, since it is also
+     * used as the tooltip when hovering a link to this item.
+     */
+    QString toHtml() const
+    {
+      if (html_.isNull())
+        html_ = document_.toHtml();
+      return html_;
+    }
+    void setTextWidth(qreal width);
+    qreal textWidth() const { return document_.textWidth(); }
+    /**
+     * Set the text width to the ideal width of the text, the same as QGraphicsTextItem::adjustSize.
+     */
+    void adjustSize();
+    void setDefaultTextColor(const QColor& color);
+
+    /**
+     * Get the link at the position.
+     * \param position The position in the coordinates of this item.
+     * \return The link href, or "" if the position is not on a link.
+     */
+    QString anchorAt(const QPointF& position);
+
+    /**
+     * Find the first occurrence of findText and replace the text from the start of its line to
+     * the end of its block with the given lines. Only this block is laid out again and repainted,
+     * so this is for small changes like values which are shown in their own block.
+     * \param findText The text to find.
+     * \param lines The new lines and the text color of each. This should have the same number of
+     * lines which are replaced so that the text size doesn't change.
+     * \return True for success, or false if findText is not found or a new line is too wide for
+     * the text width, in which case the text is not changed.
+     */
+    bool replaceLinesToEndOfBlock(const QString& findText, const std::vector<std::pair<QString, QColor> >& lines);
+
+    QRectF boundingRect() const override;
 
     AeraGraphicsItem* parent_;
 
   protected:
+    /**
+     * Only do work when the hovered link changes. Then highlight the linked item and set the
+     * tooltip to its HTML.
+     */
     void hoverMoveEvent(QGraphicsSceneHoverEvent* event) override;
+    void hoverLeaveEvent(QGraphicsSceneHoverEvent* event) override;
     void mousePressEvent(QGraphicsSceneMouseEvent* mouseEvent) override;
+    void mouseMoveEvent(QGraphicsSceneMouseEvent* mouseEvent) override;
+    void mouseReleaseEvent(QGraphicsSceneMouseEvent* mouseEvent) override;
+    void mouseDoubleClickEvent(QGraphicsSceneMouseEvent* mouseEvent) override;
+    void keyPressEvent(QKeyEvent* event) override;
+    void focusOutEvent(QFocusEvent* event) override;
+    /**
+     * If there is a selection, show a menu to copy it. Otherwise, let the parent show its menu.
+     */
+    void contextMenuEvent(QGraphicsSceneContextMenuEvent* event) override;
+    /**
+     * Don't paint the text when the view scale is below LabelLevelOfDetail, since the
+     * parent AeraGraphicsItem paints a label instead.
+     */
+    void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget = 0) override;
+
+  private:
+    /**
+     * Call before changing the layout of document_.
+     */
+    void beginLayoutChange();
+
+    /**
+     * If hoveredLink_ is set, clear it and clear the hover highlight, cursor and tool tip which
+     * hoverMoveEvent set for it.
+     */
+    void clearHoveredLink();
+
+    /**
+     * Set linkRects_ from the anchor fragments of the laid out document_.
+     */
+    void setLinkRects();
+
+    /**
+     * Get the position in document_ of the character nearest to the point.
+     * \param position The position in the coordinates of this item.
+     * \return The cursor position.
+     */
+    int hitTest(const QPointF& position) const;
+
+    /**
+     * Set selection_ and repaint if it changed.
+     * \param selection The new selection.
+     */
+    void setSelection(const QTextCursor& selection);
+
+    /**
+     * Copy the selected text to the clipboard.
+     * \param mode The clipboard mode, such as QClipboard::Selection for the X11 selection.
+     */
+    void copySelection(QClipboard::Mode mode = QClipboard::Clipboard);
+
+    QTextDocument document_;
+    QColor defaultTextColor_;
+    // The rectangle of each line of each link, and the link href. This is set by setLinkRects().
+    std::vector<std::pair<QRectF, QString> > linkRects_;
+    bool linkRectsAreSet_;
+    // The cached result of toHtml(), or null if not computed.
+    mutable QString html_;
+    // The link under the mouse cursor from the previous hoverMoveEvent, or "" for none.
+    QString hoveredLink_;
+    // The link where the mouse button was pressed, which is activated if it is released there.
+    QString pressedLink_;
+    // The selected text, or a cursor without a selection.
+    QTextCursor selection_;
   };
   friend TextItem;
 
+  /**
+   * Paint the item according to the level of detail of the view scale. At full detail, paint the
+   * polygon (and the textItem_ paints itself). Below LabelLevelOfDetail, paint the polygon with
+   * label_. Below RectangleLevelOfDetail, only fill the bounding rectangle.
+   */
+  void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget = 0) override;
+
   void contextMenuEvent(QGraphicsSceneContextMenuEvent* event) override;
   QVariant itemChange(GraphicsItemChange change, const QVariant& value) override;
   void hoverEnterEvent(QGraphicsSceneHoverEvent* event) override;
@@ -312,15 +509,32 @@ protected:
    * Set the textItem_ to the given html and create the border polygon. Use the textItemTextColor given to the constructor.
    * Connect the textItem_ to textItemLinkActivated, with default behavior which a derived class can override.
    * \param html The HTML for the textItem_.
-   * \param prependHeaderHtml If false, use html as-is. If true, first set the text 
-   * to html and adjust the size, then set the text to headerHtml_+html. We do this because
-   * the header has a right-aligned table cell which needs to "know" the width of the text.
+   * \param prependHeaderHtml If false, use html as-is. If true, set the text to headerHtml_+html.
+   * The header has a right-aligned table cell, so the text size is adjusted to the ideal width
+   * of the body and header together.
    * \param shape (optional) The shape of the item. If omitted, use SHAPE_RECTANGLE.
    * \param targetWidth (optional) The target screen width of the item. If omitted of if this is 
    * less than the default width based on the item contents, then it is ignored.
+   * If the item is dehydrated, this only measures the text in a shared QTextDocument and saves
+   * the HTML, so that rehydrate() creates the textItem_ when the item comes near the viewport.
    */
   virtual void setTextItemAndPolygon(QString html, bool prependHeaderHtml, Shape shape = SHAPE_RECTANGLE, qreal targetWidth = 0);
 
+  /**
+   * Set the text to the html and adjust it to its ideal width. If the item is dehydrated, only
+   * measure the text in a shared QTextDocument and save the HTML for rehydrate(). Otherwise,
+   * replace the textItem_.
+   * \param html The full HTML of the text.
+   * \return The size of the text.
+   */
+  QSizeF setTextHtml(const QString& html);
+
+  /**
+   * Set the position of the textItem_, or save it for rehydrate() if the item is dehydrated.
+   * \param pos The position in item coordinates.
+   */
+  void setTextPos(const QPointF& pos);
+
   virtual void textItemLinkActivated(const QString& link);
 
   AeraVisualizerScene* parent_;
@@ -331,10 +545,39 @@ protected:
   AnchoredHorizontalLine* horizontalLine_;
 
 private:
+  /**
+   * Get the links to add for the labels of object's referenced mdl, cst, mk.rdx, fact
+   * and |fact objects.
+   * \param object The object with the references.
+   * \param replicodeObjects the ReplicodeObjects for looking up labels.
+   * \return A hash of the label to the HTML link from makeHtmlLink.
+   */
+  static QHash<QString, QString> getSourceCodeHtmlLinks(
+    r_code::Code* object, const ReplicodeObjects& replicodeObjects);
+
+  /**
+   * Scan the input once, replacing each label in labelLinks with its link, and
+   * optionally doing the replacements of htmlify (but not useNowrap). Labels inside an
+   * existing <a></a> are not linked, and HTML tags in the input are copied as is.
+   * \param input The input string.
+   * \param labelLinks The hash from getSourceCodeHtmlLinks. This may be empty.
+   * \param useHtmlify If true, also do the replacements of htmlify.
+   * \return The new string.
+   */
+  static QString annotateSourceCode(
+    const QString& input, const QHash<QString, QString>& labelLinks, bool useHtmlify);
+
   AeraEvent* aeraEvent_;
   QList<Arrow*> arrows_;
   QColor textItemTextColor_;
   QPen savedPen_;
+  // The header prefix and the object label, for painting below LabelLevelOfDetail.
+  QStaticText label_;
+  bool isDehydrated_;
+  // The textItem_ HTML, text width and position, saved by dehydrate().
+  QString dehydratedHtml_;
+  qreal dehydratedTextWidth_;
+  QPointF dehydratedTextPos_;
 };
 
 }
@@ -68,6 +68,7 @@
 #include <QGraphicsSceneMouseEvent>
 #include <QGraphicsView>
 #include <QApplication>
+#include <QPainter>
 
 using namespace std;
 using namespace std::chrono;
@@ -87,12 +88,19 @@ AeraVisualizerScene::AeraVisualizerScene(
   onSceneSelected_(onSceneSelected),
   essencePropertyObject_(replicodeObjects.getObject("essence")),
   didInitialFit_(false),
+  showTimeline_(false),
+  timestampTop_(0),
   thisFrameTime_(seconds(0)),
   thisFrameLeft_(0),
   borderFlashPen_(Qt::green, 3),
   noFlashColor_("black"),
   valueUpFlashColor_("green"),
-  valueDownFlashColor_("red")
+  valueDownFlashColor_("red"),
+  batchDepth_(0),
+  batchSavedIndexMethod_(BspTreeIndex),
+  firstShiftedGroup_(0),
+  groupsMaxNextTop_(qQNaN()),
+  maxDehydratedWidth_(0)
 {
   lineColor_ = Qt::black;
   setBackgroundBrush(QColor(245, 245, 245));
@@ -114,6 +122,32 @@ AeraVisualizerScene::AeraVisualizerScene(
     eventTypeFirstTop_[0] = 5;
 }
 
+AeraVisualizerScene::~AeraVisualizerScene()
+{
+  // The pooled arrows and lines are not in the scene, so the QGraphicsScene destructor doesn't delete them.
+  for (auto arrow = arrowPool_.begin(); arrow != arrowPool_.end(); ++arrow)
+    delete *arrow;
+  for (auto line = horizontalLinePool_.begin(); line != horizontalLinePool_.end(); ++line)
+    delete *line;
+  // Likewise the dehydrated items.
+  for (auto entry = dehydratedItems_.begin(); entry != dehydratedItems_.end(); ++entry)
+    delete entry->second;
+}
+
+void AeraVisualizerScene::recycleArrow(Arrow* arrow)
+{
+  if (arrow->scene())
+    arrow->scene()->removeItem(arrow);
+  arrowPool_.push_back(arrow);
+}
+
+void AeraVisualizerScene::recycleHorizontalLine(AnchoredHorizontalLine* line)
+{
+  if (line->scene())
+    line->scene()->removeItem(line);
+  horizontalLinePool_.push_back(line);
+}
+
 void AeraVisualizerScene::addAeraGraphicsItem(AeraGraphicsItem* item)
 {
   auto aeraEvent = item->getAeraEvent();
@@ -140,22 +174,9 @@ void AeraVisualizerScene::addAeraGraphicsItem(AeraGraphicsItem* item)
       auto line = addLine(sceneRect().left(), y, sceneRect().right(), y, QPen(Qt::darkGray, 1));
       line->setZValue(-2000);
 
-      // Add all the frame boundary lines and timestamps.
-      for (auto frameTime = replicodeObjects_.getTimeReference(); true; frameTime += replicodeObjects_.getSamplingPeriod()) {
-        int frameLeft = getTimelineX(frameTime);
-        if (frameLeft > sceneRect().right())
-          break;
-
-        auto line = addLine(frameLeft, sceneRect().top(), frameLeft, sceneRect().bottom(),
-          QPen(Qt::lightGray, 1, Qt::DashLine));
-        line->setZValue(-2000);
-        auto text = addText(replicodeObjects_.relativeTime(frameTime).c_str());
-        text->setZValue(-100);
-        text->setDefaultTextColor(Qt::darkGray);
-        text->setPos(frameLeft, 0);
-        // Save the text so that we can adjust the position.
-        timestampTexts_.push_back(text);
-      }
+      // drawBackground and drawForeground paint the frame boundary lines and timestamps.
+      showTimeline_ = true;
+      update();
     }
   }
 
@@ -182,10 +203,19 @@ void AeraVisualizerScene::addAeraGraphicsItem(AeraGraphicsItem* item)
           this, "P" + QString::number(solutionId), AeraGraphicsItem::Color_proponent_justifications);
 
       itemGroups_[addSentence->graphId_] = itemGroup;
-      // Put in back of the grid lines.
+      // Put in back of the other items.
       itemGroup->setZValue(-2100);
       addItem(itemGroup);
+
+      // Stack the new group below the others.
+      groupStackIndexes_[itemGroup] = groupStack_.size();
+      groupStack_.push_back(itemGroup);
+      groupOffsets_.push_back();
+      groupAppliedOffsets_.push_back(groupOffsets_.get(groupStack_.size() - 1));
     }
+    else
+      // Apply a pending shift so that the group's next top is current.
+      applyGroupOffset(itemGroup);
   }
 
   if (qIsNaN(aeraEvent->itemTopLeftPosition_.x())) {
@@ -193,8 +223,7 @@ void AeraVisualizerScene::addAeraGraphicsItem(AeraGraphicsItem* item)
     // Only update positions based on time for the main scene.
     if (isMainScene_ && aeraEvent->time_ >= thisFrameTime_ + replicodeObjects_.getSamplingPeriod()) {
       // Start a new frame (or the first frame).
-      auto relativeTime = duration_cast<microseconds>(aeraEvent->time_ - replicodeObjects_.getTimeReference());
-      thisFrameTime_ = aeraEvent->time_ - (relativeTime % replicodeObjects_.getSamplingPeriod());
+      thisFrameTime_ = aeraEvent->frameStartTime_;
       thisFrameLeft_ = getTimelineX(thisFrameTime_);
       // Reset the top.
       eventTypeNextTop_.clear();
@@ -207,12 +236,9 @@ void AeraVisualizerScene::addAeraGraphicsItem(AeraGraphicsItem* item)
       // This is a recognized event type.
       eventType = aeraEvent->eventType_;
 
-    if (aeraEvent->eventType_ == AutoFocusNewObjectEvent::EVENT_TYPE) {
-      auto mkVal = aeraEvent->object_->get_reference(0);
-      if (essencePropertyObject_ && mkVal->references_size() >= 2 && mkVal->get_reference(1) == essencePropertyObject_)
-        // Override to group essence facts with non-assigned types at the bottom.
-        eventType = 0;
-    }
+    if (aeraEvent->eventType_ == AutoFocusNewObjectEvent::EVENT_TYPE && aeraEvent->isEssenceFact_)
+      // Override to group essence facts with non-assigned types at the bottom.
+      eventType = 0;
 
     // Compute top.
     qreal top;
@@ -220,12 +246,10 @@ void AeraVisualizerScene::addAeraGraphicsItem(AeraGraphicsItem* item)
       if (!qIsNaN(itemGroup->getNextTop()))
         top = itemGroup->getNextTop();
       else {
-        // First position for this group. Get the lowest nextTop of all the item groups.
+        // First position for this group. Put it below the lowest nextTop of all the item groups.
         top = focusSimulationNextTop_;
-        for (auto otherGroup = itemGroups_.begin(); otherGroup != itemGroups_.end(); ++otherGroup) {
-          if (!qIsNaN(otherGroup->second->getNextTop()))
-            top = max(top, otherGroup->second->getNextTop());
-        }
+        if (!qIsNaN(groupsMaxNextTop_))
+          top = max(top, groupsMaxNextTop_);
       }
 
       top += 10;
@@ -241,9 +265,7 @@ void AeraVisualizerScene::addAeraGraphicsItem(AeraGraphicsItem* item)
           top = eventTypeFirstTop_[eventType];
 
           if (thisFrameTime_ - replicodeObjects_.getTimeReference() < milliseconds(150) &&
-              eventType == AutoFocusNewObjectEvent::EVENT_TYPE &&
-              aeraEvent->object_->get_reference(0)->references_size() >= 2 &&
-              aeraEvent->object_->get_reference(0)->get_reference(1) == replicodeObjects_.getObject("essence"))
+              eventType == AutoFocusNewObjectEvent::EVENT_TYPE && aeraEvent->isEssenceFact_)
             // Debug: The first essence item. Override to make the same types of values line up. Should use a layout algorithm.
             top = 296;
         }
@@ -267,27 +289,18 @@ void AeraVisualizerScene::addAeraGraphicsItem(AeraGraphicsItem* item)
 
     qreal left;
     if (isSimulationEventType) {
-      // Position simulated items exactly.
-      if (aeraEvent->eventType_ == ModelPredictionFromRequirementDisabledEvent::EVENT_TYPE)
-        // Special case. aeraEvent->object_ is null, so use the strong_requirement.
-        left = getTimelineX(((_Fact*)((ModelPredictionFromRequirementDisabledEvent*)aeraEvent)->strong_requirement_
-                                       ->get_reference(0)->get_reference(0))->get_after());
-      else if (aeraEvent->eventType_ == PromotedSimulatedPredictionDefeatEvent::EVENT_TYPE)
-        // Special case. aeraEvent->object_ is null, so use the input_.
-        left = getTimelineX(((_Fact*)((PromotedSimulatedPredictionDefeatEvent*)aeraEvent)->input_
-                                       ->get_reference(0)->get_reference(0))->get_after());
-      else {
-        // We know that a simulated item's object usually has the form (fact (goal_or_pred (fact ...)))
-        if (((_Fact*)aeraEvent->object_)->get_goal())
-          // Position a goal at the time it needs to be achieved by.
-          left = getTimelineX(((_Fact*)aeraEvent->object_->get_reference(0)->get_reference(0))->get_before()) -
-            item->boundingRect().width();
-        else if (((_Fact*)aeraEvent->object_)->get_pred())
-          left = getTimelineX(((_Fact*)aeraEvent->object_->get_reference(0)->get_reference(0))->get_after());
-        else
-          // No goal or pred, just a solo fact. Position like a goal.
-          left = getTimelineX(((_Fact*)aeraEvent->object_)->get_after());
-      }
+      // Position simulated items exactly. We know that a simulated item's object usually has the
+      // form (fact (goal_or_pred (fact ...))), and setDerivedAttributes has the target times.
+      if (!aeraEvent->object_)
+        // Special case for ModelPredictionFromRequirementDisabledEvent and PromotedSimulatedPredictionDefeatEvent.
+        // object_ is null, so targetAfter_ is from the strong_requirement_ or input_. Always use the after time.
+        left = getTimelineX(aeraEvent->targetAfter_);
+      else if (aeraEvent->goalOrPred_ == AeraEvent::GOAL_OR_PRED_GOAL)
+        // Position a goal at the time it needs to be achieved by.
+        left = getTimelineX(aeraEvent->targetBefore_) - item->boundingRect().width();
+      else
+        // A pred, or just a solo fact where targetAfter_ is the fact's own time.
+        left = getTimelineX(aeraEvent->targetAfter_);
     }
     else {
       if (aeraEvent->eventType_ == IoDeviceInjectEvent::EVENT_TYPE ||
@@ -305,48 +318,271 @@ void AeraVisualizerScene::addAeraGraphicsItem(AeraGraphicsItem* item)
     aeraEvent->itemInitialTopLeftPosition_ = aeraEvent->itemTopLeftPosition_;
 
   addItem(item);
+  indexAeraGraphicsItem(item);
   // Adjust the position from the topLeft.
   item->setPos(aeraEvent->itemTopLeftPosition_ - item->boundingRect().topLeft());
   item->adjustItemYPosition();
   if (itemGroup) {
     qreal saveHeight = itemGroup->boundingRect().height();
     itemGroup->addChild(item);
+    updateGroupsMaxNextTop(itemGroup->getNextTop());
     
     qreal deltaHeight = itemGroup->boundingRect().height() - saveHeight;
-    if (saveHeight > 1 && deltaHeight > 0) {
-      // Shift overlapping groups down by deltaHeight.
-      for (auto otherGroup = itemGroups_.begin(); otherGroup != itemGroups_.end(); ++otherGroup) {
-        if (otherGroup->second->pos().y() > itemGroup->pos().y())
-          otherGroup->second->setPos(otherGroup->second->pos().x(),
-                                     otherGroup->second->pos().y() + deltaHeight);
-      }
+    size_t iBelowGroup = groupStackIndexes_[itemGroup] + 1;
+    if (saveHeight > 1 && deltaHeight > 0 && iBelowGroup < groupStack_.size()) {
+      // Shift the groups below down by deltaHeight. applyGroupOffsets moves them.
+      groupOffsets_.shiftFrom(iBelowGroup, deltaHeight);
+      firstShiftedGroup_ = min(firstShiftedGroup_, iBelowGroup);
+      // The shift is not applied yet, so include it now. The lowest group is usually below this one.
+      if (!qIsNaN(groupsMaxNextTop_))
+        groupsMaxNextTop_ += deltaHeight;
     }
+
+    if (batchDepth_ == 0)
+      applyGroupOffsets();
   }
+
+  if (item->isDehydrated())
+    // A new item starts as a shell with only its size. rehydrateIfNearViewport or virtualizeItems
+    // creates its text when it is visible near the viewport.
+    dehydrateAeraGraphicsItem(item);
 }
 
 void AeraVisualizerScene::removeAeraGraphicsItem(AeraGraphicsItem* item) {
+  rehydrateAeraGraphicsItem(item);
   if (item->getAeraEvent()->eventType_ == AbaAddSentence::EVENT_TYPE) {
     auto itemGroup = getItemGroup(((AbaAddSentence*)item->getAeraEvent())->graphId_);
     if (itemGroup) {
+      // Move the group and its children to their current place first.
+      applyGroupOffset(itemGroup);
       itemGroup->removeChild(item);
       // TODO: Remove itemGroup if it is empty. (Remember its position for it we step forward again?)
     }
   }
 
+  // If this item was highlighted, restore its pen since it may be stepped again, and null it out
+  if (currentMatch_ == item) {
+    item->restorePen();
+    currentMatch_ = NULL;
+  }
+  for (int i = 0; i < allMatches_.size(); i++) {
+    if (allMatches_.at(i) == item) {
+      item->restorePen();
+      allMatches_.erase(allMatches_.begin() + i);
+    }
+  }
+
   removeItem(item);
+  unindexAeraGraphicsItem(item);
+}
+
+void AeraVisualizerScene::restoreAeraGraphicsItem(AeraGraphicsItem* item) {
+  addItem(item);
+  indexAeraGraphicsItem(item);
+  if (item->getAeraEvent()->eventType_ == AbaAddSentence::EVENT_TYPE) {
+    auto itemGroup = getItemGroup(((AbaAddSentence*)item->getAeraEvent())->graphId_);
+    if (itemGroup) {
+      applyGroupOffset(itemGroup);
+      itemGroup->addChild(item);
+    }
+  }
+
+  item->reattachArrowsAndHorizontalLine();
+}
+
+void AeraVisualizerScene::beginBatch()
+{
+  if (batchDepth_++ > 0)
+    // Already in a batch.
+    return;
+
+  // Changing the index method discards the index. It is rebuilt once in commitBatch.
+  batchSavedIndexMethod_ = itemIndexMethod();
+  setItemIndexMethod(NoIndex);
+  foreach(QGraphicsView* view, views())
+    view->viewport()->setUpdatesEnabled(false);
+}
+
+void AeraVisualizerScene::commitBatch()
+{
+  if (batchDepth_ <= 0 || --batchDepth_ > 0)
+    // Not in a batch, or not the outer batch.
+    return;
+
+  applyGroupOffsets();
+  if (isMainScene_)
+    // Rehydrate the new items which are visible near the viewport.
+    virtualizeItems();
+  setItemIndexMethod(batchSavedIndexMethod_);
+  foreach(QGraphicsView* view, views())
+    view->viewport()->setUpdatesEnabled(true);
+  update();
 }
 
 void AeraVisualizerScene::onViewMoved()
 {
   if (views().size() >= 1) {
-    // Always position the timestamps at the top of the screen.
-    qreal sceneY = views().at(0)->mapToScene(0, 0).y();
-    foreach(QGraphicsTextItem * text, timestampTexts_)
-      text->setPos(text->x(), sceneY);
+    if (showTimeline_) {
+      // drawForeground paints the timestamps at the top of the view. The view scrolled the old
+      // timestamps with the scene, so repaint where they were and where they go now.
+      QGraphicsView* view = views().at(0);
+      qreal sceneY = view->mapToScene(0, 0).y();
+      if (sceneY != timestampTop_) {
+        update(QRectF(sceneRect().left(), timestampTop_, sceneRect().width(), getTimestampHeight()));
+        update(QRectF(sceneRect().left(), sceneY, sceneRect().width(), getTimestampHeight()));
+        timestampTop_ = sceneY;
+      }
+    }
 
     for (auto itemGroup = itemGroups_.begin(); itemGroup != itemGroups_.end(); ++itemGroup)
       itemGroup->second->onParentViewMoved();
+
+    if (isMainScene_)
+      virtualizeItems();
+  }
+}
+
+void AeraVisualizerScene::virtualizeItems()
+{
+  if (batchDepth_ > 0)
+    // The view is not updated during a batch.
+    return;
+
+  qreal keepLeft, keepRight;
+  getVirtualizationRange(keepLeft, keepRight);
+
+  // First collect the changes, since dehydrating and rehydrating modify the containers.
+  vector<AeraGraphicsItem*> toDehydrate;
+  for (auto item = hydratedItems_.begin(); item != hydratedItems_.end(); ++item) {
+    if ((*item)->isSelected() || *item == mouseGrabberItem())
+      // Keep an item which the user is working with.
+      continue;
+
+    QRectF rect = (*item)->sceneBoundingRect();
+    if (!(*item)->isVisible() || rect.right() < keepLeft || rect.left() > keepRight)
+      // Also release the text of an item hidden by an unchecked category.
+      toDehydrate.push_back(*item);
   }
+
+  vector<AeraGraphicsItem*> toRehydrate;
+  for (auto entry = dehydratedItems_.lower_bound(keepLeft - maxDehydratedWidth_);
+       entry != dehydratedItems_.end() && entry->first <= keepRight; ++entry) {
+    if (entry->second->isVisible() && entry->second->sceneBoundingRect().right() >= keepLeft)
+      toRehydrate.push_back(entry->second);
+  }
+
+  if (toDehydrate.size() == 0 && toRehydrate.size() == 0)
+    return;
+
+  for (auto item = toDehydrate.begin(); item != toDehydrate.end(); ++item)
+    dehydrateAeraGraphicsItem(*item);
+  for (auto item = toRehydrate.begin(); item != toRehydrate.end(); ++item)
+    rehydrateAeraGraphicsItem(*item);
+}
+
+void AeraVisualizerScene::getVirtualizationRange(qreal& keepLeft, qreal& keepRight)
+{
+  QGraphicsView* view = views().at(0);
+  QRectF viewRect = view->mapToScene(view->viewport()->rect()).boundingRect();
+  keepLeft = viewRect.left() - virtualizationFrameMargin_ * frameWidth_;
+  keepRight = viewRect.right() + virtualizationFrameMargin_ * frameWidth_;
+}
+
+void AeraVisualizerScene::dehydrateAeraGraphicsItem(AeraGraphicsItem* item)
+{
+  hydratedItems_.erase(item);
+  item->dehydrate();
+  removeItem(item);
+
+  QRectF rect = item->sceneBoundingRect();
+  dehydratedItemLefts_[item] = dehydratedItems_.insert(make_pair(rect.left(), item));
+  maxDehydratedWidth_ = max(maxDehydratedWidth_, rect.width());
+}
+
+void AeraVisualizerScene::rehydrateAeraGraphicsItem(AeraGraphicsItem* item)
+{
+  auto entry = dehydratedItemLefts_.find(item);
+  if (entry == dehydratedItemLefts_.end())
+    return;
+
+  dehydratedItems_.erase(entry->second);
+  dehydratedItemLefts_.erase(entry);
+  addItem(item);
+  item->rehydrate();
+  hydratedItems_.insert(item);
+}
+
+void AeraVisualizerScene::rehydrateIfNearViewport(AeraGraphicsItem* item)
+{
+  if (batchDepth_ > 0 || !item->isDehydrated() || !item->isVisible())
+    // The outer commitBatch() calls virtualizeItems().
+    return;
+
+  qreal keepLeft, keepRight;
+  getVirtualizationRange(keepLeft, keepRight);
+  QRectF rect = item->sceneBoundingRect();
+  if (rect.right() >= keepLeft && rect.left() <= keepRight)
+    rehydrateAeraGraphicsItem(item);
+}
+
+void AeraVisualizerScene::rehydrateAllAeraGraphicsItems()
+{
+  while (dehydratedItems_.size() > 0)
+    rehydrateAeraGraphicsItem(dehydratedItems_.begin()->second);
+}
+
+int AeraVisualizerScene::getTimestampHeight()
+{
+  // Match the document margin of a QGraphicsTextItem.
+  return QFontMetrics(font()).height() + 2 * timestampMargin_;
+}
+
+void AeraVisualizerScene::drawBackground(QPainter* painter, const QRectF& rect)
+{
+  QGraphicsScene::drawBackground(painter, rect);
+  if (!showTimeline_)
+    return;
+
+  // Draw the frame boundary lines which are in the exposed rect.
+  painter->save();
+  painter->setPen(QPen(Qt::lightGray, 1, Qt::DashLine));
+  qreal right = min(rect.right(), sceneRect().right());
+  for (int iFrame = max(0, (int)floor(rect.left() / frameWidth_)); true; ++iFrame) {
+    qreal frameLeft = iFrame * frameWidth_;
+    if (frameLeft > right)
+      break;
+    painter->drawLine(QPointF(frameLeft, rect.top()), QPointF(frameLeft, rect.bottom()));
+  }
+  painter->restore();
+}
+
+void AeraVisualizerScene::drawForeground(QPainter* painter, const QRectF& rect)
+{
+  QGraphicsScene::drawForeground(painter, rect);
+  if (!showTimeline_ || views().size() < 1)
+    return;
+
+  // Draw the timestamps at the top of the view which are in the exposed rect.
+  qreal top = views().at(0)->mapToScene(0, 0).y();
+  if (rect.top() > top + getTimestampHeight() || rect.bottom() < top)
+    return;
+
+  painter->save();
+  painter->setPen(Qt::darkGray);
+  painter->setFont(font());
+  qreal ascent = QFontMetrics(font()).ascent();
+  qreal right = min(rect.right(), sceneRect().right());
+  // A timestamp starts at its frame's left, so include the frame which overlaps the left of the rect.
+  for (int iFrame = max(0, (int)floor(rect.left() / frameWidth_)); true; ++iFrame) {
+    qreal frameLeft = iFrame * frameWidth_;
+    if (frameLeft > right)
+      break;
+
+    auto frameTime = replicodeObjects_.getTimeReference() + iFrame * replicodeObjects_.getSamplingPeriod();
+    painter->drawText(QPointF(frameLeft + timestampMargin_, top + timestampMargin_ + ascent),
+      replicodeObjects_.relativeTime(frameTime).c_str());
+  }
+  painter->restore();
 }
 
 void AeraVisualizerScene::mousePressEvent(QGraphicsSceneMouseEvent* mouseEvent)
@@ -374,11 +610,11 @@ void AeraVisualizerScene::mouseReleaseEvent(QGraphicsSceneMouseEvent* mouseEvent
   QGraphicsScene::mouseReleaseEvent(mouseEvent);
 }
 
-void AeraVisualizerScene::addArrow(
+Arrow* AeraVisualizerScene::addArrow(
   AeraGraphicsItem* startItem, AeraGraphicsItem* endItem, AeraGraphicsItem* lhsItem)
 {
   if (startItem == endItem)
-    return;
+    return NULL;
 
   QPen highlightArrowBasePen = Arrow::HighlightedPen;
   QPen highlightArrowTipPen = Arrow::HighlightedPen;
@@ -390,20 +626,30 @@ void AeraVisualizerScene::addArrow(
     highlightArrowBasePen = Arrow::GreenArrowheadPen;
     highlightArrowTipPen = Arrow::RedArrowheadPen;
   }
-  addArrow(startItem, endItem, Arrow::HighlightedPen, highlightArrowBasePen, highlightArrowTipPen);
+  return addArrow(startItem, endItem, Arrow::HighlightedPen, highlightArrowBasePen, highlightArrowTipPen);
 }
 
-void AeraVisualizerScene::addArrow(
+Arrow* AeraVisualizerScene::addArrow(
     AeraGraphicsItem* startItem, AeraGraphicsItem* endItem, const QPen& highlightBodyPen,
     const QPen& highlightArrowBasePen, const QPen& highlightArrowTipPen)
 {
-  auto arrow = new Arrow(startItem, endItem, highlightBodyPen, highlightArrowBasePen, highlightArrowTipPen, this);
+  Arrow* arrow;
+  if (arrowPool_.size() > 0) {
+    arrow = arrowPool_.back();
+    arrowPool_.pop_back();
+    arrow->reset(startItem, endItem, highlightBodyPen, highlightArrowBasePen, highlightArrowTipPen);
+  }
+  else
+    arrow = new Arrow(startItem, endItem, highlightBodyPen, highlightArrowBasePen, highlightArrowTipPen, this);
 
   startItem->addArrow(arrow);
   endItem->addArrow(arrow);
   arrow->setZValue(-1000.0);
-  addItem(arrow);
+  if (!(startItem->isDehydrated() && endItem->isDehydrated()))
+    // Otherwise, AeraGraphicsItem::rehydrate() adds it.
+    addItem(arrow);
   arrow->updatePosition();
+  return arrow;
 }
 
 void AeraVisualizerScene::addHorizontalLine(AeraGraphicsItem* item)
@@ -411,47 +657,209 @@ void AeraVisualizerScene::addHorizontalLine(AeraGraphicsItem* item)
   if (item->getAeraEvent()->object_ &&
       (item->getAeraEvent()->object_->code(0).asOpcode() == r_exec::Opcodes::Fact ||
        item->getAeraEvent()->object_->code(0).asOpcode() == r_exec::Opcodes::AntiFact)) {
-    auto fact = (_Fact*)item->getAeraEvent()->object_;
-    Timestamp after, before;
-
-    auto goal = fact->get_goal();
-    if (goal) {
-      // Use the timings of the goal target.
-      after = goal->get_target()->get_after();
-      before = goal->get_target()->get_before();
+    // Use the timings of the goal or prediction target, or of the fact itself.
+    Timestamp after = item->getAeraEvent()->targetAfter_;
+    Timestamp before = item->getAeraEvent()->targetBefore_;
+
+    AnchoredHorizontalLine* line;
+    if (horizontalLinePool_.size() > 0) {
+      line = horizontalLinePool_.back();
+      horizontalLinePool_.pop_back();
+      line->reset(item, getTimelineX(after), getTimelineX(before));
     }
-    else {
-      auto pred = fact->get_pred();
-      if (pred) {
-        // Use the timings of the prediction target.
-        after = pred->get_target()->get_after();
-        before = pred->get_target()->get_before();
-      }
-      else {
-        after = fact->get_after();
-        before = fact->get_before();
-      }
-    }
-
-    auto line = new AnchoredHorizontalLine(item, getTimelineX(after), getTimelineX(before));
+    else
+      line = new AnchoredHorizontalLine(item, getTimelineX(after), getTimelineX(before));
     item->setHorizontalLine(line);
     line->setZValue(-1001.0);
-    addItem(line);
+    if (!item->isDehydrated())
+      // Otherwise, AeraGraphicsItem::rehydrate() adds it.
+      addItem(line);
     line->updatePosition();
   }
 }
 
-AeraGraphicsItem* AeraVisualizerScene::getAeraGraphicsItem(Code* object)
+void AeraVisualizerScene::indexAeraGraphicsItem(AeraGraphicsItem* item)
 {
-  foreach(QGraphicsItem* item, items()) {
-    auto graphicsItem = dynamic_cast<AeraGraphicsItem*>(item);
-    if (graphicsItem) {
-      if (graphicsItem->getAeraEvent()->object_ == object)
-        return graphicsItem;
+  if (isMainScene_)
+    hydratedItems_.insert(item);
+  eventTypeItems_[item->getAeraEvent()->eventType_].insert(item);
+  if (item->borderFlashCountdown_ > 0)
+    // A new item starts with a flash countdown.
+    flashingItems_.insert(item);
+  updateSkyline(item);
+  auto property = getAutoFocusProperty(item);
+  if (property)
+    autoFocusPropertyItems_[property].insert(item);
+
+  auto object = item->getAeraEvent()->object_;
+  if (!object)
+    return;
+
+  objectItems_[object] = item;
+  parent_->registerAeraGraphicsItem(object, this, item);
+}
+
+void AeraVisualizerScene::unindexAeraGraphicsItem(AeraGraphicsItem* item)
+{
+  hydratedItems_.erase(item);
+  removeFromSkyline(item);
+  auto eventTypeEntry = eventTypeItems_.find(item->getAeraEvent()->eventType_);
+  if (eventTypeEntry != eventTypeItems_.end())
+    eventTypeEntry->second.erase(item);
+  flashingItems_.erase(item);
+  auto property = getAutoFocusProperty(item);
+  if (property) {
+    auto propertyEntry = autoFocusPropertyItems_.find(property);
+    if (propertyEntry != autoFocusPropertyItems_.end())
+      propertyEntry->second.erase(item);
+  }
+
+  auto object = item->getAeraEvent()->object_;
+  if (!object)
+    return;
+
+  auto entry = objectItems_.find(object);
+  if (entry != objectItems_.end() && entry->second == item)
+    objectItems_.erase(entry);
+  parent_->unregisterAeraGraphicsItem(object, item);
+}
+
+qreal AeraVisualizerScene::getSkylineFreeTop(AeraGraphicsItem* item, qreal top, qreal margin)
+{
+  auto skyline = frameSkylines_.find(item->getAeraEvent()->frameStartTime_);
+  if (skyline == frameSkylines_.end())
+    return top;
+
+  return skyline->second.getFreeTop(top, item->sceneBoundingRect().height(), margin);
+}
+
+void AeraVisualizerScene::updateSkyline(AeraGraphicsItem* item)
+{
+  removeFromSkyline(item);
+
+  auto aeraEvent = item->getAeraEvent();
+  if ((item->scene() != this && !item->isDehydrated()) || !item->isVisible())
+    // A dehydrated item is not in the scene but keeps its place in the skyline.
+    return;
+  if (AeraVisualizerWindow::simulationEventTypes_.find(aeraEvent->eventType_) !=
+      AeraVisualizerWindow::simulationEventTypes_.end())
+    return;
+  if (aeraEvent->itemInitialTopLeftPosition_ != aeraEvent->itemTopLeftPosition_)
+    // The user moved the item, so other items don't move for it.
+    return;
+
+  auto frameStartTime = aeraEvent->frameStartTime_;
+  QRectF rect = item->sceneBoundingRect();
+  frameSkylines_[frameStartTime].insert(item, rect.top(), rect.bottom());
+  skylineItemFrames_[item] = frameStartTime;
+}
+
+void AeraVisualizerScene::removeFromSkyline(AeraGraphicsItem* item)
+{
+  auto frame = skylineItemFrames_.find(item);
+  if (frame == skylineItemFrames_.end())
+    return;
+
+  auto skyline = frameSkylines_.find(frame->second);
+  if (skyline != frameSkylines_.end()) {
+    skyline->second.erase(item);
+    if (skyline->second.empty())
+      frameSkylines_.erase(skyline);
+  }
+  skylineItemFrames_.erase(frame);
+}
+
+void AeraVisualizerScene::Skyline::insert(AeraGraphicsItem* item, qreal top, qreal bottom)
+{
+  erase(item);
+  itemExtents_[item] = extents_.insert(make_pair(top, make_pair(bottom, item)));
+  maxHeight_ = max(maxHeight_, bottom - top);
+}
+
+void AeraVisualizerScene::Skyline::erase(AeraGraphicsItem* item)
+{
+  auto extent = itemExtents_.find(item);
+  if (extent == itemExtents_.end())
+    return;
+
+  extents_.erase(extent->second);
+  itemExtents_.erase(extent);
+}
+
+qreal AeraVisualizerScene::Skyline::getFreeTop(qreal top, qreal height, qreal margin) const
+{
+  while (true) {
+    // An extent which starts more than maxHeight_ above the top can't reach it.
+    bool isColliding = false;
+    qreal lowestBottom = top;
+    for (auto extent = extents_.lower_bound(top - maxHeight_);
+         extent != extents_.end() && extent->first < top + height; ++extent) {
+      if (extent->second.first > top) {
+        isColliding = true;
+        lowestBottom = max(lowestBottom, extent->second.first);
+      }
     }
+
+    if (!isColliding)
+      return top;
+    // Move below the lowest colliding item and check again.
+    top = lowestBottom + margin;
   }
+}
+
+void AeraVisualizerScene::applyGroupOffset(AeraGraphicsItemGroup* itemGroup)
+{
+  size_t iGroup = groupStackIndexes_[itemGroup];
+  qreal offset = groupOffsets_.get(iGroup);
+  qreal delta = offset - groupAppliedOffsets_[iGroup];
+  if (delta == 0)
+    return;
+
+  // The group's itemChange also moves its children.
+  itemGroup->setPos(itemGroup->pos().x(), itemGroup->pos().y() + delta);
+  groupAppliedOffsets_[iGroup] = offset;
+}
+
+void AeraVisualizerScene::applyGroupOffsets()
+{
+  for (size_t i = firstShiftedGroup_; i < groupStack_.size(); ++i)
+    applyGroupOffset(groupStack_[i]);
+  firstShiftedGroup_ = groupStack_.size();
+}
+
+void AeraVisualizerScene::GroupOffsets::push_back()
+{
+  // The new node n covers the differences in (n - lowbit(n), n]. Its own difference is zero.
+  size_t n = tree_.size() + 1;
+  size_t lowbit = n & (~n + 1);
+  tree_.push_back(getPrefixSum(n - 1) - getPrefixSum(n - lowbit));
+}
+
+void AeraVisualizerScene::GroupOffsets::shiftFrom(size_t i, qreal delta)
+{
+  for (size_t j = i + 1; j <= tree_.size(); j += j & (~j + 1))
+    tree_[j - 1] += delta;
+}
+
+qreal AeraVisualizerScene::GroupOffsets::getPrefixSum(size_t n) const
+{
+  qreal sum = 0;
+  for (size_t j = n; j > 0; j -= j & (~j + 1))
+    sum += tree_[j - 1];
+  return sum;
+}
+
+Code* AeraVisualizerScene::getAutoFocusProperty(AeraGraphicsItem* item)
+{
+  if (!dynamic_cast<AutoFocusFactItem*>(item))
+    return NULL;
 
-  return 0;
+  auto mkVal = item->getAeraEvent()->object_->get_reference(0);
+  // TODO: Is this reference always the property?
+  if (mkVal->references_size() < 2)
+    return NULL;
+
+  return mkVal->get_reference(1);
 }
 
 // Redo highlights in case something's changed
@@ -504,14 +912,16 @@ void AeraVisualizerScene::scaleViewBy(double factor)
 
 void AeraVisualizerScene::zoomViewHome()
 {
-  // Get the bounding rect of all AeraGraphicsItem. This excludes lines such as frame boundaries.
+  // Get the bounding rect of all AeraGraphicsItem, including dehydrated items. This excludes lines such as frame boundaries.
   QRectF boundingRect;
-  foreach(QGraphicsItem* item, items()) {
-    if (dynamic_cast<AeraGraphicsItem*>(item) && item->isVisible()) {
-      if (boundingRect.width() == 0)
-        boundingRect = item->sceneBoundingRect();
-      else
-        boundingRect = boundingRect.united(item->sceneBoundingRect());
+  for (auto entry = eventTypeItems_.begin(); entry != eventTypeItems_.end(); ++entry) {
+    for (auto item = entry->second.begin(); item != entry->second.end(); ++item) {
+      if ((*item)->isVisible()) {
+        if (boundingRect.width() == 0)
+          boundingRect = (*item)->sceneBoundingRect();
+        else
+          boundingRect = boundingRect.united((*item)->sceneBoundingRect());
+      }
     }
   }
 
@@ -524,6 +934,7 @@ void AeraVisualizerScene::zoomViewHome()
 void AeraVisualizerScene::centerOnItem(QGraphicsItem *item) {
   auto aeraGraphicsItem = dynamic_cast<AeraGraphicsItem*>(item);
   if (aeraGraphicsItem) {
+    rehydrateAeraGraphicsItem(aeraGraphicsItem);
     if (!aeraGraphicsItem->isVisible())
       aeraGraphicsItem->setItemAndArrowsAndHorizontalLineVisible(true);
 
@@ -535,6 +946,7 @@ void AeraVisualizerScene::focusOnItem(QGraphicsItem* item)
 {
   auto aeraGraphicsItem = dynamic_cast<AeraGraphicsItem*>(item);
   if (aeraGraphicsItem) {
+    rehydrateAeraGraphicsItem(aeraGraphicsItem);
     if (!aeraGraphicsItem->isVisible())
       aeraGraphicsItem->setItemAndArrowsAndHorizontalLineVisible(true);
 
@@ -561,9 +973,7 @@ void AeraVisualizerScene::zoomToItem(QGraphicsItem* item)
 }
 
 void AeraVisualizerScene::scrollToTimestamp(core::Timestamp timestamp) {
-  auto relativeTime = duration_cast<microseconds>(timestamp - replicodeObjects_.getTimeReference());
-  auto frameStartTime = timestamp - (relativeTime % replicodeObjects_.getSamplingPeriod());
-  qreal xPos = getTimelineX(frameStartTime);
+  qreal xPos = getTimelineX(getFrameStartTime(timestamp));
   // This point marks the top left of the scrolled scene
   // it is used to keep the same y position while scrolling
   QGraphicsView* view = views().at(0);
@@ -573,20 +983,28 @@ void AeraVisualizerScene::scrollToTimestamp(core::Timestamp timestamp) {
 
 void AeraVisualizerScene::setItemsVisible(int eventType, bool visible)
 {
-  foreach(QGraphicsItem * item, items()) {
-    auto aeraGraphicsItem = dynamic_cast<AeraGraphicsItem*>(item);
-    if (aeraGraphicsItem && aeraGraphicsItem->getAeraEvent()->eventType_ == eventType)
-      aeraGraphicsItem->setItemAndArrowsAndHorizontalLineVisible(visible);
-  }
+  auto entry = eventTypeItems_.find(eventType);
+  if (entry == eventTypeItems_.end())
+    return;
+
+  for (auto item = entry->second.begin(); item != entry->second.end(); ++item)
+    (*item)->setItemAndArrowsAndHorizontalLineVisible(visible);
+}
+
+void AeraVisualizerScene::setItemsVisible(const set<int>& eventTypes, bool visible)
+{
+  for (auto eventType = eventTypes.begin(); eventType != eventTypes.end(); ++eventType)
+    setItemsVisible(*eventType, visible);
 }
 
 void AeraVisualizerScene::setNonItemsVisible(const set<int>& notEventTypes, bool visible)
 {
-  foreach(QGraphicsItem * item, items()) {
-    auto aeraGraphicsItem = dynamic_cast<AeraGraphicsItem*>(item);
-    if (aeraGraphicsItem && 
-        notEventTypes.find(aeraGraphicsItem->getAeraEvent()->eventType_) == notEventTypes.end())
-      aeraGraphicsItem->setItemAndArrowsAndHorizontalLineVisible(visible);
+  for (auto entry = eventTypeItems_.begin(); entry != eventTypeItems_.end(); ++entry) {
+    if (notEventTypes.find(entry->first) != notEventTypes.end())
+      continue;
+
+    for (auto item = entry->second.begin(); item != entry->second.end(); ++item)
+      (*item)->setItemAndArrowsAndHorizontalLineVisible(visible);
   }
 }
 
@@ -596,36 +1014,31 @@ void AeraVisualizerScene::setAutoFocusItemsVisible(const string& property, bool
   if (!propertyObject)
     return;
 
-  foreach(QGraphicsItem * item, items()) {
-    auto autoFocusItem = dynamic_cast<AutoFocusFactItem*>(item);
-    if (autoFocusItem) {
-      auto mkVal = autoFocusItem->getAeraEvent()->object_->get_reference(0);
-      // TODO: Is this reference always the property?
-      if (mkVal->references_size() < 2)
-        continue;
-
-      auto mkValProperty = mkVal->get_reference(1);
-      if (mkValProperty == propertyObject)
-        autoFocusItem->setItemAndArrowsAndHorizontalLineVisible(visible);
-    }
-  }
+  auto entry = autoFocusPropertyItems_.find(propertyObject);
+  if (entry == autoFocusPropertyItems_.end())
+    return;
+
+  for (auto item = entry->second.begin(); item != entry->second.end(); ++item)
+    (*item)->setItemAndArrowsAndHorizontalLineVisible(visible);
 }
 
-void AeraVisualizerScene::removeAllItemsByEventType(const set<int>& eventTypes)
+void AeraVisualizerScene::removeAllItemsByEventType(
+  const set<int>& eventTypes, vector<AeraGraphicsItem*>& removedItems)
 {
-  // First find the items to delete without deleting, which modifies items().
-  vector<AeraGraphicsItem*> toDelete;
-  foreach(QGraphicsItem * item, items()) {
-    auto aeraGraphicsItem = dynamic_cast<AeraGraphicsItem*>(item);
-    if (aeraGraphicsItem &&
-      eventTypes.find(aeraGraphicsItem->getAeraEvent()->eventType_) != eventTypes.end())
-      toDelete.push_back(aeraGraphicsItem);
+  // First copy the items to remove, since removeAeraGraphicsItem modifies eventTypeItems_.
+  vector<AeraGraphicsItem*> toRemove;
+  for (auto eventType = eventTypes.begin(); eventType != eventTypes.end(); ++eventType) {
+    auto entry = eventTypeItems_.find(*eventType);
+    if (entry != eventTypeItems_.end())
+      toRemove.insert(toRemove.end(), entry->second.begin(), entry->second.end());
   }
 
-  for (auto item = toDelete.begin(); item != toDelete.end(); ++item) {
-    (*item)->removeArrowsAndHorizontalLine();
+  for (auto item = toRemove.begin(); item != toRemove.end(); ++item) {
+    // Rehydrate first so that its arrows and horizontal line are in the scene to detach.
+    rehydrateAeraGraphicsItem(*item);
+    (*item)->detachArrowsAndHorizontalLine();
     removeAeraGraphicsItem(*item);
-    delete *item;
+    removedItems.push_back(*item);
   }
 }
 
@@ -633,10 +1046,12 @@ void AeraVisualizerScene::abaSetBinding(int varNumber, const QString& text)
 {
   set<AeraGraphicsItemGroup*> toRefit;
 
-  foreach(QGraphicsItem * item, items()) {
-    auto abaItem = dynamic_cast<AbaSentenceItem*>(item);
-    if (abaItem) {
-      if (abaItem->setBinding(varNumber, text)) {
+  // Use eventTypeItems_ which also has the dehydrated items.
+  auto entry = eventTypeItems_.find(AbaAddSentence::EVENT_TYPE);
+  if (entry != eventTypeItems_.end()) {
+    for (auto item = entry->second.begin(); item != entry->second.end(); ++item) {
+      auto abaItem = dynamic_cast<AbaSentenceItem*>(*item);
+      if (abaItem && abaItem->setBinding(varNumber, text)) {
         // The item was changed, so need to re-fit its group box.
         auto itemGroup = getItemGroup(((AbaAddSentence*)abaItem->getAeraEvent())->graphId_);
         if (itemGroup)
@@ -652,8 +1067,12 @@ void AeraVisualizerScene::abaSetBinding(int varNumber, const QString& text)
 
 void AeraVisualizerScene::abaRemoveBinding(int varNumber)
 {
-  foreach(QGraphicsItem * item, items()) {
-    auto abaItem = dynamic_cast<AbaSentenceItem*>(item);
+  auto entry = eventTypeItems_.find(AbaAddSentence::EVENT_TYPE);
+  if (entry == eventTypeItems_.end())
+    return;
+
+  for (auto item = entry->second.begin(); item != entry->second.end(); ++item) {
+    auto abaItem = dynamic_cast<AbaSentenceItem*>(*item);
     if (abaItem)
       abaItem->removeBinding(varNumber);
   }
@@ -684,60 +1103,60 @@ void AeraVisualizerScene::timerEvent(QTimerEvent* event)
     // This timer event is not for us.
     return;
 
-  bool isFlashing = false;
-  foreach(QGraphicsItem* item, items()) {
-    auto aeraGraphicsItem = dynamic_cast<AeraGraphicsItem*>(item);
-    if (!aeraGraphicsItem)
-      continue;
+  for (auto item = flashingItems_.begin(); item != flashingItems_.end(); ) {
+    auto aeraGraphicsItem = *item;
+    bool isFlashing = false;
 
     if (aeraGraphicsItem->borderFlashCountdown_ > 0) {
-      isFlashing = true;
-
       --aeraGraphicsItem->borderFlashCountdown_;
       if (aeraGraphicsItem->borderFlashCountdown_ % 2 == 1)
         aeraGraphicsItem->setPen(borderFlashPen_);
       else
         aeraGraphicsItem->setPen(aeraGraphicsItem->getBorderNoHighlightPen());
+      isFlashing = (isFlashing || aeraGraphicsItem->borderFlashCountdown_ > 0);
     }
 
-    auto modelItem = dynamic_cast<ModelItem*>(item);
+    auto modelItem = dynamic_cast<ModelItem*>(aeraGraphicsItem);
     if (modelItem) {
       if (modelItem->strengthFlashCountdown_ > 0) {
-        isFlashing = true;
-
         --modelItem->strengthFlashCountdown_;
         if (modelItem->strengthFlashCountdown_ % 2 == 1)
           modelItem->setStrengthColor
           (modelItem->strengthIncreased_ ? valueUpFlashColor_ : valueDownFlashColor_);
         else
           modelItem->setStrengthColor(noFlashColor_);
+        isFlashing = (isFlashing || modelItem->strengthFlashCountdown_ > 0);
       }
 
       if (modelItem->evidenceCountFlashCountdown_ > 0) {
-        isFlashing = true;
-
         --modelItem->evidenceCountFlashCountdown_;
         if (modelItem->evidenceCountFlashCountdown_ % 2 == 1)
           modelItem->setEvidenceCountColor
           (modelItem->evidenceCountIncreased_ ? valueUpFlashColor_ : valueDownFlashColor_);
         else
           modelItem->setEvidenceCountColor(noFlashColor_);
+        isFlashing = (isFlashing || modelItem->evidenceCountFlashCountdown_ > 0);
       }
 
       if (modelItem->successRateFlashCountdown_ > 0) {
-        isFlashing = true;
-
         --modelItem->successRateFlashCountdown_;
         if (modelItem->successRateFlashCountdown_ % 2 == 1)
           modelItem->setSuccessRateColor
           (modelItem->successRateIncreased_ ? valueUpFlashColor_ : valueDownFlashColor_);
         else
           modelItem->setSuccessRateColor(noFlashColor_);
+        isFlashing = (isFlashing || modelItem->successRateFlashCountdown_ > 0);
       }
     }
+
+    if (isFlashing)
+      ++item;
+    else
+      // All the countdowns reached zero.
+      item = flashingItems_.erase(item);
   }
 
-  if (!isFlashing) {
+  if (flashingItems_.empty()) {
     killTimer(flashTimerId_);
     flashTimerId_ = 0;
   }
@@ -56,6 +56,8 @@
 #define AERA_VISUALIZER_SCENE_HPP
 
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include "../aera-event.hpp"
 #include "../replicode-objects.hpp"
 
@@ -72,6 +74,8 @@ namespace aera_visualizer {
 
 class AeraGraphicsItem;
 class AeraGraphicsItemGroup;
+class Arrow;
+class AnchoredHorizontalLine;
 class AeraVisualizerWindow;
 class ExplanationLogWindow;
 
@@ -84,7 +88,10 @@ public:
     ReplicodeObjects& replicodeObjects, AeraVisualizerWindow* parent, bool isMainScene,
     const OnSceneSelected& onSceneSelected);
 
+  ~AeraVisualizerScene();
+
   AeraVisualizerWindow* getParent() { return parent_; }
+  bool isMainScene() { return isMainScene_; }
 
   void zoomToItem(QGraphicsItem* item);
   void focusOnItem(QGraphicsItem* item);
@@ -104,10 +111,66 @@ public:
   }
 
   /**
-   * This is called by the QGraphicsView instance when the view is moved.
+   * Get the start time of the frame which contains the timestamp.
+   * \param timestamp The timestamp.
+   * \return The frame start time.
+   */
+  core::Timestamp getFrameStartTime(core::Timestamp timestamp)
+  {
+    auto relativeTime = std::chrono::duration_cast<std::chrono::microseconds>(timestamp - replicodeObjects_.getTimeReference());
+    return timestamp - (relativeTime % replicodeObjects_.getSamplingPeriod());
+  }
+
+  /**
+   * Get the first top at or below the given top where the item does not collide with the
+   * items in the skyline of its frame, as used by AeraGraphicsItem::adjustItemYPosition.
+   * \param item The item to place. It should not be in the skyline.
+   * \param top The top in scene coordinates where the item would like to be.
+   * \param margin If the item collides, place it this far below the item it collides with.
+   * \return The top in scene coordinates.
+   */
+  qreal getSkylineFreeTop(AeraGraphicsItem* item, qreal top, qreal margin);
+
+  /**
+   * Remove the item from the skyline of its frame. Then, if the item is in this scene, visible,
+   * not a simulation item and at its initial position, add it back with its current vertical extent.
+   * This is called when the item is moved, shown or hidden.
+   * \param item The AeraGraphicsItem.
+   */
+  void updateSkyline(AeraGraphicsItem* item);
+
+  /**
+   * Remove the item from the skyline of its frame, if it is there.
+   * \param item The AeraGraphicsItem.
+   */
+  void removeFromSkyline(AeraGraphicsItem* item);
+
+  /**
+   * This is called by the QGraphicsView instance when the view is moved. In the main scene, this
+   * also calls virtualizeItems().
    */
   void onViewMoved();
 
+  /**
+   * If the item was dehydrated by virtualizeItems(), add it back to the scene and rehydrate it.
+   * \param item The AeraGraphicsItem.
+   */
+  void rehydrateAeraGraphicsItem(AeraGraphicsItem* item);
+
+  /**
+   * If the item is a dehydrated shell which is visible and within virtualizationFrameMargin_ frame
+   * widths of the viewport, rehydrate it now. Otherwise, leave it for virtualizeItems(). This is
+   * called when an item is shown, so that an item hidden by an unchecked category never builds its text.
+   * \param item The AeraGraphicsItem.
+   */
+  void rehydrateIfNearViewport(AeraGraphicsItem* item);
+
+  /**
+   * Rehydrate all the dehydrated items, for example before rendering the whole scene. The next
+   * onViewMoved() dehydrates the items which are far from the viewport again.
+   */
+  void rehydrateAllAeraGraphicsItems();
+
   /**
    * Set the set of detail OIDs for simulation items which should be shown at the top.
    * \param focusSimulationDetailOids The set of detail OIDs, which is copied.
@@ -135,6 +198,51 @@ public:
       flashTimerId_ = startTimer(200);
   }
 
+  /**
+   * Add the item to flashingItems_ so that the flash timer counts down its flash countdowns.
+   * The item leaves flashingItems_ when all its countdowns reach zero or it is removed from the scene.
+   * \param item The AeraGraphicsItem which has a positive flash countdown.
+   */
+  void addFlashingItem(AeraGraphicsItem* item) { flashingItems_.insert(item); }
+
+  /**
+   * Begin a batch of changes to the scene, such as adding many items while stepping
+   * a frame. This suspends the item index and the updates of the views until the
+   * matching commitBatch(). Batches may be nested, and only the outer commitBatch()
+   * takes effect.
+   */
+  void beginBatch();
+
+  /**
+   * End the batch started by beginBatch(). At the outer level, rebuild the item index
+   * once and repaint the views once.
+   */
+  void commitBatch();
+
+  /**
+   * Remove the arrow from the scene (if it is in a scene) and keep it for reuse by addArrow.
+   * The caller must already have removed it from the arrow lists of its items.
+   * \param arrow The Arrow, which must have been created by this scene's addArrow.
+   */
+  void recycleArrow(Arrow* arrow);
+
+  /**
+   * Remove the line from the scene (if it is in a scene) and keep it for reuse by addHorizontalLine.
+   * \param line The AnchoredHorizontalLine, which must have been created by this scene's addHorizontalLine.
+   */
+  void recycleHorizontalLine(AnchoredHorizontalLine* line);
+
+  /**
+   * Raise groupsMaxNextTop_ to the item group's next top if it is lower. AeraGraphicsItemGroup
+   * calls this when the group moves.
+   * \param nextTop The group's getNextTop(), which may be qQNaN().
+   */
+  void updateGroupsMaxNextTop(qreal nextTop)
+  {
+    if (!qIsNaN(nextTop) && (qIsNaN(groupsMaxNextTop_) || nextTop > groupsMaxNextTop_))
+      groupsMaxNextTop_ = nextTop;
+  }
+
   // Anything on this list will be highlighted
   AeraGraphicsItem* currentMatch_ = NULL;
   std::vector<AeraGraphicsItem*> allMatches_;
@@ -149,6 +257,16 @@ protected:
   void mousePressEvent(QGraphicsSceneMouseEvent* mouseEvent) override;
   void mouseReleaseEvent(QGraphicsSceneMouseEvent* mouseEvent) override;
   void timerEvent(QTimerEvent* event) override;
+
+  /**
+   * Draw the background, and the frame boundary lines which are in the rect.
+   */
+  void drawBackground(QPainter* painter, const QRectF& rect) override;
+
+  /**
+   * Draw the timestamp of each frame in the rect at the top of the view.
+   */
+  void drawForeground(QPainter* painter, const QRectF& rect) override;
 #if QT_CONFIG(wheelevent)
   void wheelEvent(QGraphicsSceneWheelEvent* event) override;
 #endif
@@ -156,15 +274,134 @@ protected:
 private:
   friend class AeraVisualizerWindow;
 
+  /**
+   * A Skyline holds the vertical extents of the items in one frame column, sorted by top, so
+   * that getFreeTop can find the next place for an item without asking the scene for colliding items.
+   */
+  class Skyline {
+  public:
+    Skyline()
+      : maxHeight_(0)
+    {}
+
+    void insert(AeraGraphicsItem* item, qreal top, qreal bottom);
+
+    void erase(AeraGraphicsItem* item);
+
+    bool empty() const { return extents_.empty(); }
+
+    /**
+     * Get the first top at or below the given top where an extent with the height does not
+     * overlap an extent in the skyline. If it overlaps, try again below the lowest overlapping
+     * extent plus the margin.
+     */
+    qreal getFreeTop(qreal top, qreal height, qreal margin) const;
+
+  private:
+    typedef std::multimap<qreal, std::pair<qreal, AeraGraphicsItem*> > Extents;
+    // Key is the top, value is the bottom and the item.
+    Extents extents_;
+    std::unordered_map<AeraGraphicsItem*, Extents::iterator> itemExtents_;
+    // The largest height inserted, which limits how far up getFreeTop has to look.
+    qreal maxHeight_;
+  };
+
+  /**
+   * GroupOffsets is a Fenwick tree of the vertical offsets of the item groups in stacking order.
+   * The tree holds the differences between the offsets of consecutive groups, so shiftFrom shifts
+   * all the groups from an index to the end in O(log n), and get returns the offset of one group
+   * in O(log n).
+   */
+  class GroupOffsets {
+  public:
+    /**
+     * Add a group at the end. Its offset is the offset of the group before it, since later
+     * shifts of that group also shift this one.
+     */
+    void push_back();
+
+    /**
+     * Add delta to the offset of each group from index i to the end.
+     */
+    void shiftFrom(size_t i, qreal delta);
+
+    /**
+     * Get the total offset of group i.
+     */
+    qreal get(size_t i) const { return getPrefixSum(i + 1); }
+
+  private:
+    /**
+     * Get the sum of the first n differences.
+     */
+    qreal getPrefixSum(size_t n) const;
+
+    // tree_[j - 1] is the sum of the differences in the range (j - lowbit(j), j].
+    std::vector<qreal> tree_;
+  };
+
   /**
    * Scale the first QGraphicsView by the given factor.
    * This also sets currentScaleFactor.
    */
   void scaleViewBy(double factor);
   void zoomViewHome();
+
+  /**
+   * Get the height of the timestamps painted by drawForeground.
+   */
+  int getTimestampHeight();
   void addAeraGraphicsItem(AeraGraphicsItem* item);
+
+  /**
+   * Remove the item from the scene and its item group, and remove it from currentMatch_ and
+   * allMatches_. This does not delete the item or its arrows. If the item is dehydrated, this first
+   * rehydrates it, so a caller which detaches its arrows should rehydrate it before that.
+   * \param item The AeraGraphicsItem to remove.
+   */
   void removeAeraGraphicsItem(AeraGraphicsItem* item);
 
+  /**
+   * Move the item group by the offset from groupOffsets_ which is not yet applied. This moves its
+   * children too.
+   * \param itemGroup The AeraGraphicsItemGroup, which must be in groupStack_.
+   */
+  void applyGroupOffset(AeraGraphicsItemGroup* itemGroup);
+
+  /**
+   * Call applyGroupOffset for every group which may have a pending offset. This is called at the
+   * end of addAeraGraphicsItem, or by the outer commitBatch() so that a batch moves each group once.
+   */
+  void applyGroupOffsets();
+
+  /**
+   * Get the range of scene x coordinates within virtualizationFrameMargin_ frame widths of the viewport.
+   * \param keepLeft Set this to the left of the range.
+   * \param keepRight Set this to the right of the range.
+   */
+  void getVirtualizationRange(qreal& keepLeft, qreal& keepRight);
+
+  /**
+   * Call AeraGraphicsItem::dehydrate() and remove the item from the scene. It stays in the
+   * item indexes so that it can still be found by object, event type or frame.
+   * \param item The AeraGraphicsItem, which must be in hydratedItems_.
+   */
+  void dehydrateAeraGraphicsItem(AeraGraphicsItem* item);
+
+  /**
+   * Dehydrate the items which are more than virtualizationFrameMargin_ frame widths to the left or
+   * right of the viewport or are hidden, and rehydrate the visible dehydrated items which are within
+   * that distance. This keeps the number of items with a QTextDocument in the scene bounded by the viewport.
+   */
+  void virtualizeItems();
+
+  /**
+   * Add back an item which was removed by removeAllItemsByEventType, at its same position, and
+   * reattach its arrows and horizontal line.
+   * \param item The AeraGraphicsItem to restore.
+   */
+  void restoreAeraGraphicsItem(AeraGraphicsItem* item);
+
   /**
    * Add an Arrow to the scene.
    * \param startItem The Item for the start of the arrow.
@@ -173,8 +410,9 @@ private:
    * next to lhsItem will have highlight pen RedArrowheadPen and the other item
    * will have highlight pen Green.ArrowheadPen . If omitted, both arrowheads will
    * have highlight pens HighlightedPen.
+   * \return The new Arrow, or NULL if startItem and endItem are the same.
    */
-  void addArrow(AeraGraphicsItem* startItem, AeraGraphicsItem* endItem, AeraGraphicsItem* lhsItem = 0);
+  Arrow* addArrow(AeraGraphicsItem* startItem, AeraGraphicsItem* endItem, AeraGraphicsItem* lhsItem = 0);
 
   /**
    * Add an Arrow to the scene.
@@ -183,17 +421,47 @@ private:
    * \param highlightBodyPen See the Arrow constructor.
    * \param highlightArrowBasePen See the Arrow constructor.
    * \param highlightArrowTipPen See the Arrow constructor.
+   * \return The new Arrow.
    */
-  void addArrow(AeraGraphicsItem* startItem, AeraGraphicsItem* endItem,
+  Arrow* addArrow(AeraGraphicsItem* startItem, AeraGraphicsItem* endItem,
     const QPen& highlightBodyPen, const QPen& highlightArrowBasePen, const QPen& highlightArrowTipPen);
 
   void addHorizontalLine(AeraGraphicsItem* item);
   /**
-   * Get the AeraGraphicsItem whose getAeraEvent() has the given object.
+   * Get the AeraGraphicsItem whose getAeraEvent() has the given object. This uses objectItems_
+   * so it does not scan the scene.
    * \param object The Code* object to search for.
    * \return The AeraGraphicsItem, or null if not found.
    */
-  AeraGraphicsItem* getAeraGraphicsItem(r_code::Code* object);
+  AeraGraphicsItem* getAeraGraphicsItem(r_code::Code* object)
+  {
+    auto result = objectItems_.find(object);
+    if (result == objectItems_.end())
+      return 0;
+    return result->second;
+  }
+
+  /**
+   * Add the item to objectItems_, eventTypeItems_ and autoFocusPropertyItems_, and register it
+   * with the parent window. If another item has the same object, this item replaces it in
+   * objectItems_.
+   * \param item The AeraGraphicsItem which was added to the scene.
+   */
+  void indexAeraGraphicsItem(AeraGraphicsItem* item);
+
+  /**
+   * Remove the item from objectItems_, eventTypeItems_ and autoFocusPropertyItems_, and
+   * unregister it from the parent window.
+   * \param item The AeraGraphicsItem which was removed from the scene.
+   */
+  void unindexAeraGraphicsItem(AeraGraphicsItem* item);
+
+  /**
+   * If the item is an AutoFocusFactItem for (fact (mk.val X Y ...)), get the property Y.
+   * \param item The AeraGraphicsItem.
+   * \return The property, or NULL if the item is not an AutoFocusFactItem or has no property.
+   */
+  static r_code::Code* getAutoFocusProperty(AeraGraphicsItem* item);
 
   /**
    * Find all items with the given event type, and call setItemAndArrowsAndHorizontalLineVisible.
@@ -202,6 +470,13 @@ private:
    */
   void setItemsVisible(int eventType, bool visible);
 
+  /**
+   * Find all items where the event type is any of the given values, and call setItemAndArrowsAndHorizontalLineVisible.
+   * \param eventTypes The event types of the item's getAeraEvent().
+   * \param visible The visible state for setItemAndArrowsAndHorizontalLineVisible.
+   */
+  void setItemsVisible(const std::set<int>& eventTypes, bool visible);
+
   /**
    * Find all items where the event type is not any of the given values, and call setItemAndArrowsAndHorizontalLineVisible.
    * \param notEventTypes Call setItemAndArrowsAndHorizontalLineVisible if the event type of the item's getAeraEvent() is not any of these values.
@@ -217,11 +492,12 @@ private:
   void setAutoFocusItemsVisible(const std::string& property, bool visible);
   
   /**
-   * Find all items where the event type is any of the given values, and call removeArrowsAndHorizontalLine,
-   * removeItem and delete the item.
+   * Find all items where the event type is any of the given values, and call detachArrowsAndHorizontalLine
+   * and removeAeraGraphicsItem. This does not delete the items, so that restoreAeraGraphicsItem can add them back.
    * \param eventTypes Remove if the event type of the item's getAeraEvent() is any of these values.
+   * \param removedItems Append each removed item. The caller takes ownership.
    */
-  void removeAllItemsByEventType(const std::set<int>& eventTypes);
+  void removeAllItemsByEventType(const std::set<int>& eventTypes, std::vector<AeraGraphicsItem*>& removedItems);
 
   void abaSetBinding(int varNumber, const QString& text);
 
@@ -233,7 +509,10 @@ private:
   OnSceneSelected onSceneSelected_;
   r_code::Code* essencePropertyObject_;
   bool didInitialFit_;
-  QList<QGraphicsTextItem*> timestampTexts_;
+  // True when drawBackground and drawForeground should paint the frame boundary lines and timestamps.
+  bool showTimeline_;
+  // The scene Y of the timestamps painted by drawForeground, which is the top of the view.
+  qreal timestampTop_;
   // key: The AeraEvent eventType_, or 0 for "other". value: The top of the first item for that event type.
   std::map<int, qreal> eventTypeFirstTop_;
   // key: The AeraEvent eventType_, or 0 for "other". value: The top to use for the next item added for that event type.
@@ -248,10 +527,55 @@ private:
   QString valueUpFlashColor_;
   QString valueDownFlashColor_;
   int flashTimerId_;
+  // The items in the scene which have a positive flash countdown. The flash timer only visits these.
+  std::unordered_set<AeraGraphicsItem*> flashingItems_;
+  // The nesting level of beginBatch().
+  int batchDepth_;
+  // The item index method to restore in the outer commitBatch().
+  ItemIndexMethod batchSavedIndexMethod_;
   std::set<int> focusSimulationDetailOids_;
   // The key is the group ID.
   std::map<int, AeraGraphicsItemGroup*> itemGroups_;
+  // The item groups from top to bottom, in the order that they were stacked by addAeraGraphicsItem.
+  std::vector<AeraGraphicsItemGroup*> groupStack_;
+  // Key is an item group, value is its index in groupStack_.
+  std::unordered_map<AeraGraphicsItemGroup*, size_t> groupStackIndexes_;
+  // The offset of each group in groupStack_ when the group grew above it.
+  GroupOffsets groupOffsets_;
+  // The offset from groupOffsets_ which was applied to each group in groupStack_.
+  std::vector<qreal> groupAppliedOffsets_;
+  // The index of the first group in groupStack_ which may have an offset to apply.
+  size_t firstShiftedGroup_;
+  // The maximum getNextTop() of the item groups, or qQNaN() if none. This only increases, so that
+  // a new group is below the others even if the user moved a group. See updateGroupsMaxNextTop.
+  qreal groupsMaxNextTop_;
+  // Key is the frame start time, value is the skyline of the non-simulation items in the frame.
+  std::map<core::Timestamp, Skyline> frameSkylines_;
+  // Key is an item in frameSkylines_, value is the frame start time of its skyline.
+  std::unordered_map<AeraGraphicsItem*, core::Timestamp> skylineItemFrames_;
+  // Key is the object of the item's getAeraEvent(), value is the item in the scene.
+  std::unordered_map<r_code::Code*, AeraGraphicsItem*> objectItems_;
+  // Key is the eventType_ of the item's getAeraEvent(), value is the items in the scene with that type.
+  std::map<int, std::unordered_set<AeraGraphicsItem*> > eventTypeItems_;
+  // Key is the property Y of an AutoFocusFactItem for (fact (mk.val X Y ...)), value is the items
+  // in the scene with that property.
+  std::unordered_map<r_code::Code*, std::unordered_set<AeraGraphicsItem*> > autoFocusPropertyItems_;
+  // The items in the main scene which are in the scene and not dehydrated.
+  std::unordered_set<AeraGraphicsItem*> hydratedItems_;
+  // Key is the left of a dehydrated item in scene coordinates, value is the item, which is not in
+  // the scene. The scene deletes these items in its destructor.
+  std::multimap<qreal, AeraGraphicsItem*> dehydratedItems_;
+  std::unordered_map<AeraGraphicsItem*, std::multimap<qreal, AeraGraphicsItem*>::iterator> dehydratedItemLefts_;
+  // The largest width of an item added to dehydratedItems_, which limits how far left virtualizeItems has to look.
+  qreal maxDehydratedWidth_;
+  // Items farther than this many frame widths to the left or right of the viewport are dehydrated.
+  static const int virtualizationFrameMargin_ = 3;
+  // Arrows and lines which were removed, for reuse by addArrow and addHorizontalLine.
+  std::vector<Arrow*> arrowPool_;
+  std::vector<AnchoredHorizontalLine*> horizontalLinePool_;
   static const int frameWidth_ = 330;
+  // The margin around a timestamp, like the document margin of a QGraphicsTextItem.
+  static const int timestampMargin_ = 4;
 };
 
 }
@@ -73,6 +73,17 @@ AnchoredHorizontalLine::AnchoredHorizontalLine(
   setPen(DefaultPen);
 }
 
+void AnchoredHorizontalLine::reset(QGraphicsPolygonItem* item, qreal left, qreal right)
+{
+  item_ = item;
+  left_ = left;
+  right_ = right;
+  setSelected(false);
+  setVisible(true);
+  setZValue(0);
+  setPen(DefaultPen);
+}
+
 QRectF AnchoredHorizontalLine::boundingRect() const
 {
   qreal extra = (pen().width() + 20) / 2.0;
@@ -102,17 +113,6 @@ void AnchoredHorizontalLine::updatePosition()
     setVisible(true);
 
   // TODO: Correct end points.
-  QPointF itemCenter = item_->pos() + item_->boundingRect().center();
-  QLineF line(QPointF(left_, itemCenter.y()), QPointF(right_, itemCenter.y()));
-  setLine(line);
-}
-
-void AnchoredHorizontalLine::paint(QPainter* painter, const QStyleOptionGraphicsItem* option,
-  QWidget* widget)
-{
-  painter->setPen(pen());
-  painter->setBrush(pen().color());
-
   // Add the boundingRect().center() so the line goes through the center of the item.
   QPointF itemCenter = item_->pos() + item_->boundingRect().center();
   QLineF centerLine(QPointF(left_, itemCenter.y()), QPointF(right_, itemCenter.y()));
@@ -124,6 +124,14 @@ void AnchoredHorizontalLine::paint(QPainter* painter, const QStyleOptionGraphics
   rightVerticalBar_.clear();
   rightVerticalBar_ << QPointF(centerLine.x2(), centerLine.y2() - verticalBarRadius_)
                     << QPointF(centerLine.x2(), centerLine.y2() + verticalBarRadius_);
+}
+
+void AnchoredHorizontalLine::paint(QPainter* painter, const QStyleOptionGraphicsItem* option,
+  QWidget* widget)
+{
+  // The geometry is computed by updatePosition, so only draw it.
+  painter->setPen(pen());
+  painter->setBrush(pen().color());
 
   painter->drawLine(line());
   painter->drawPolygon(leftVerticalBar_);
@@ -77,6 +77,14 @@ public:
 
   AnchoredHorizontalLine(QGraphicsPolygonItem* item, qreal left, qreal right, QGraphicsItem* parent = 0);
 
+  /**
+   * Reinitialize a recycled line as if it were newly created by the constructor.
+   * \param item The item which the line moves up and down with.
+   * \param left The left end of the line.
+   * \param right The right end of the line.
+   */
+  void reset(QGraphicsPolygonItem* item, qreal left, qreal right);
+
   void setLeft(qreal left) {
     left_ = left;
     updatePosition();
@@ -91,6 +99,10 @@ public:
   QRectF boundingRect() const override;
   QPainterPath shape() const override;
 
+  /**
+   * Compute the line through the center of the item and the vertical bars at the ends, and
+   * cache them for paint(). Call this when the item moves or changes size.
+   */
   void updatePosition();
 
   static const QPen DefaultPen;
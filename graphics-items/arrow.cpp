@@ -60,6 +60,7 @@
 #include <QGraphicsSceneContextMenuEvent>
 #include <QPainter>
 #include <QGraphicsView>
+#include <QStyleOptionGraphicsItem>
 #include <QMenu>
 
 namespace aera_visualizer {
@@ -77,6 +78,7 @@ Arrow::Arrow(
   highlightBodyPen_(highlightBodyPen),
   highlightArrowBasePen_(highlightArrowBasePen),
   highlightArrowTipPen_(highlightArrowTipPen),
+  endsCollide_(false),
   wasSelected_(false),
   startItemLastPen_(DefaultPen),
   endItemLastPen_(DefaultPen)
@@ -90,6 +92,28 @@ Arrow::Arrow(
   arrowTipPen_ = DefaultPen;
 }
 
+void Arrow::reset(
+  QGraphicsPolygonItem* startItem, QGraphicsPolygonItem* endItem,
+  const QPen& highlightBodyPen, const QPen& highlightArrowBasePen,
+  const QPen& highlightArrowTipPen)
+{
+  startItem_ = startItem;
+  endItem_ = endItem;
+  highlightBodyPen_ = highlightBodyPen;
+  highlightArrowBasePen_ = highlightArrowBasePen;
+  highlightArrowTipPen_ = highlightArrowTipPen;
+  wasSelected_ = false;
+  startItemLastPen_ = DefaultPen;
+  endItemLastPen_ = DefaultPen;
+  endsCollide_ = false;
+  arrowBase_.clear();
+  arrowTip_.clear();
+  setSelected(false);
+  setVisible(true);
+  setZValue(0);
+  setPens(DefaultPen, DefaultPen, DefaultPen);
+}
+
 void Arrow::showBothSides()
 {
   QRectF boundingRect = startItem_->sceneBoundingRect();
@@ -159,15 +183,14 @@ QPainterPath Arrow::shape() const
 
 void Arrow::updatePosition()
 {
-  QLineF line(mapFromItem(startItem_, 0, 0), mapFromItem(endItem_, 0, 0));
-  setLine(line);
-}
-
-void Arrow::paint(QPainter* painter, const QStyleOptionGraphicsItem* option,
-  QWidget* widget)
-{
-  if (startItem_->collidesWithItem(endItem_))
+  endsCollide_ = startItem_->collidesWithItem(endItem_);
+  if (endsCollide_) {
+    // paint() doesn't draw the arrow, so only keep the line for the bounding rect.
+    setLine(QLineF(mapFromItem(startItem_, 0, 0), mapFromItem(endItem_, 0, 0)));
+    arrowBase_.clear();
+    arrowTip_.clear();
     return;
+  }
 
   // Add the boundingRect().center() so the arrow points to the center of the item.
   QLineF centerLine(startItem_->pos() + startItem_->boundingRect().center(), 
@@ -190,40 +213,64 @@ void Arrow::paint(QPainter* painter, const QStyleOptionGraphicsItem* option,
     line().p2() + 10 * QPointF(sin(angle + -M_PI / 2), 
                                cos(angle + -M_PI / 2)),
     angle);
+}
 
-  // If selected, change the border color of the start and end items as well as that of the arrow
-  if (isSelected()) {
-    // Remember the last pen settings if this is the first pass
-    if (!wasSelected_) {
-      startItemLastPen_ = startItem_->pen();
-      endItemLastPen_ = endItem_->pen();
+QVariant Arrow::itemChange(GraphicsItemChange change, const QVariant& value)
+{
+  if (change == QGraphicsItem::ItemSelectedHasChanged) {
+    // If selected, change the border color of the start and end items as well as that of the arrow
+    if (value.toBool()) {
+      // Remember the last pen settings if this is the first pass
+      if (!wasSelected_) {
+        startItemLastPen_ = startItem_->pen();
+        endItemLastPen_ = endItem_->pen();
+      }
+
+      // Set the colors for the arrow
+      setPens(Arrow::HighlightedPen, getHighlightArrowBasePen(), getHighlightArrowTipPen());
+
+      // Set the colors for the objects on either end
+      startItem_->setPen(Arrow::HighlightedPen);
+      endItem_->setPen(Arrow::HighlightedPen);
+
+      // Keep this updated so we can debounce the deselected state
+      wasSelected_ = true;
     }
+    else {
+      // If we just deselected the arrow, recolor the objects at the ends
+      if (wasSelected_) {
+        // Reset the arrow's pens
+        setPens(Arrow::DefaultPen, Arrow::DefaultPen, Arrow::DefaultPen);
+
+        // Reset the end objects' pens
+        startItem_->setPen(startItemLastPen_);
+        endItem_->setPen(endItemLastPen_);
+
+        // Make sure we only do this once
+        wasSelected_ = false;
+      }
+    }
+  }
 
-    // Set the colors for the arrow
-    setPens(Arrow::HighlightedPen, getHighlightArrowBasePen(), getHighlightArrowTipPen());
-    painter->setPen(Arrow::HighlightedPen);
-
-    // Set the colors for the objects on either end
-    startItem_->setPen(Arrow::HighlightedPen);
-    endItem_->setPen(Arrow::HighlightedPen);
+  return QGraphicsLineItem::itemChange(change, value);
+}
 
-    // Keep this updated so we can debounce the deselected state
-    wasSelected_ = true;
+void Arrow::paint(QPainter* painter, const QStyleOptionGraphicsItem* option,
+  QWidget* widget)
+{
+  // The geometry is computed by updatePosition, so only draw it.
+  if (endsCollide_)
+    return;
 
-  }
-  else {
-    // If we just deselected the arrow, recolor the objects at the ends
-    if (wasSelected_) {
-      // Reset the arrow's pens
-      setPens(Arrow::DefaultPen, Arrow::DefaultPen, Arrow::DefaultPen);
-
-      // Reset the end objects' pens
-      startItem_->setPen(startItemLastPen_);
-      endItem_->setPen(endItemLastPen_);
-
-      // Make sure we only do this once
-      wasSelected_ = false;
-    }
+  qreal levelOfDetail = QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform());
+  if (levelOfDetail < AeraGraphicsItem::RectangleLevelOfDetail)
+    // The items are drawn as rectangles. Leave out the arrows.
+    return;
+  if (levelOfDetail < AeraGraphicsItem::LabelLevelOfDetail) {
+    // Draw a thin line without arrowheads.
+    painter->setPen(QPen(pen().color(), 0));
+    painter->drawLine(line());
+    return;
   }
 
   // Draw the line
@@ -93,6 +93,19 @@ public:
     const QPen& highlightArrowTipPen,
     AeraVisualizerScene* parent);
 
+  /**
+   * Reinitialize a recycled arrow as if it were newly created by the constructor with
+   * the same parent.
+   * \param startItem The Item for the start of the arrow.
+   * \param endItem The Item for the end of the arrow.
+   * \param highlightBodyPen See the constructor.
+   * \param highlightArrowBasePen See the constructor.
+   * \param highlightArrowTipPen See the constructor.
+   */
+  void reset(QGraphicsPolygonItem* startItem, QGraphicsPolygonItem* endItem,
+    const QPen& highlightBodyPen, const QPen& highlightArrowBasePen,
+    const QPen& highlightArrowTipPen);
+
   int type() const override { return Type; }
   QRectF boundingRect() const override;
   QPainterPath shape() const override;
@@ -102,6 +115,11 @@ public:
   void contextMenuEvent(QGraphicsSceneContextMenuEvent* event) override;
   void showBothSides();
   void moveEndsSideBySide();
+
+  /**
+   * Compute the line between the borders of the start and end items and the arrowhead polygons,
+   * and cache them for paint(). Call this when the start or end item moves or changes size.
+   */
   void updatePosition();
 
   /**
@@ -138,6 +156,7 @@ public:
 
 protected:
   void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget = 0) override;
+  QVariant itemChange(GraphicsItemChange change, const QVariant& value) override;
 
 private:
   /**
@@ -163,6 +182,8 @@ private:
   QPen highlightBodyPen_;
   QPen highlightArrowBasePen_;
   QPen highlightArrowTipPen_;
+  // True if the start and end items collide, in which case the arrow is not drawn. Set by updatePosition.
+  bool endsCollide_;
   QPolygonF arrowBase_;
   QPolygonF arrowTip_;
   QPen arrowBasePen_;
@@ -52,11 +52,11 @@
 //_/_/ 
 //_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 
-#include <regex>
 #include <QMenu>
 #include "explanation-log-window.hpp"
 #include "../aera-visualizer-window.hpp"
 #include "aera-visualizer-scene.hpp"
+#include "source-formatter.hpp"
 #include "auto-focus-fact-item.hpp"
 
 using namespace std;
@@ -80,11 +80,9 @@ void AutoFocusFactItem::setFactMkValHtml()
   auto mkVal = autoFocusNewObjectEvent_->object_->get_reference(0);
 
   // Strip the ending confidence value and propagation of saliency threshold.
-  regex saliencyRegex("\\s+[\\w\\:]+\\)$");
-  regex confidenceAndSaliencyRegex("\\s+\\w+\\s+[\\w\\:]+\\)$");
-  string factMkValSource = regex_replace(replicodeObjects_.getSourceCode(
-    autoFocusNewObjectEvent_->object_), confidenceAndSaliencyRegex, ")");
-  string mkValSource = regex_replace(replicodeObjects_.getSourceCode(mkVal), saliencyRegex, ")");
+  string factMkValSource = SourceFormatter::stripConfidenceAndSaliency(replicodeObjects_.getSourceCode(
+    autoFocusNewObjectEvent_->object_));
+  string mkValSource = SourceFormatter::stripSaliency(replicodeObjects_.getSourceCode(mkVal));
 
   QString mkValLabel(replicodeObjects_.getLabel(mkVal).c_str());
 
@@ -93,8 +91,7 @@ void AutoFocusFactItem::setFactMkValHtml()
 
   // TODO: Show autoFocusNewObjectEvent_->syncMode_?
 
-  addSourceCodeHtmlLinks(autoFocusNewObjectEvent_->object_->get_reference(0), factMkValHtml_);
-  factMkValHtml_ = htmlify(factMkValHtml_);
+  factMkValHtml_ = htmlifyWithLinks(autoFocusNewObjectEvent_->object_->get_reference(0), factMkValHtml_);
 }
 
 void AutoFocusFactItem::textItemLinkActivated(const QString& link)
@@ -51,9 +51,7 @@
 //_/_/ 
 //_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 
-#include <regex>
-#include <algorithm>
-#include "model-item.hpp"
+#include "source-formatter.hpp"
 #include "composite-state-item.hpp"
 
 using namespace std;
@@ -69,30 +67,14 @@ CompositeStateItem::CompositeStateItem(
   newCompositeStateEvent_(newCompositeStateEvent)
 {
   // Set up sourceCodeHtml_
-  sourceCodeHtml_ = simplifyCstSource(replicodeObjects_.getSourceCode(newCompositeStateEvent->object_)).c_str();
-  addSourceCodeHtmlLinks(newCompositeStateEvent_->object_, sourceCodeHtml_);
-  sourceCodeHtml_ = htmlify(sourceCodeHtml_);
-  ModelItem::highlightVariables(sourceCodeHtml_);
+  auto cst = newCompositeStateEvent_->object_;
+  sourceCodeHtml_ = replicodeObjects_.getHtmlFragmentCache().get(cst, HtmlFragmentCache::CST_HTML, [&]() {
+    QString html = htmlifyWithLinks(cst, SourceFormatter::simplifyCstSource(replicodeObjects_.getSourceCode(cst)).c_str());
+    SourceFormatter::highlightVariables(html);
+    return html;
+  });
 
   setTextItemAndPolygon(sourceCodeHtml_, true);
 }
 
-string CompositeStateItem::simplifyCstSource(const string& cstSource)
-{
-  string result = cstSource;
-  // Temporarily replace \n with \x01 so that we match the entire string, not by line.
-  replace(result.begin(), result.end(), '\n', '\x01');
-  // Strip the set of output groups and parameters.
-  // "[\\s\\x01]+" is whitespace "[\\d\\.]+" is a float value.
-  // TODO: The original source may have comments, so need to strip these.
-  result = regex_replace(result,
-    regex("[\\s\\x01]+\\[[\\w\\s]+\\][\\s\\x01]+[\\d\\.]+[\\s\\x01]*\\)$"), ")");
-  // TODO: Correctly remove wildcards.
-  result = regex_replace(result, regex(" : :\\)"), ")");
-  result = regex_replace(result, regex(" :\\)"), ")");
-  // Restore \n.
-  replace(result.begin(), result.end(), '\x01', '\n');
-  return result;
-}
-
 }
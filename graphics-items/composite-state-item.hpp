@@ -70,14 +70,6 @@ public:
     NewCompositeStateEvent* newCompositeStateEvent, ReplicodeObjects& replicodeObjects, 
     AeraVisualizerScene* parent);
 
-  /**
-   * Start with the source from replicodeObjects_.getSourceCode for a cst, and
-   * remove the set of output groups and parameters, and remove trailing wildcards.
-   * \param cstSource The source from replicodeObjects_.getSourceCode.
-   * \return The simplified source code
-   */
-  static std::string simplifyCstSource(const std::string& cstSource);
-
 private:
   NewCompositeStateEvent* newCompositeStateEvent_;
   QString sourceCodeHtml_;
@@ -51,7 +51,6 @@
 //_/_/ 
 //_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 
-#include <regex>
 #include <QMenu>
 #include "../explanation-log-window.hpp"
 #include "../aera-visualizer-window.hpp"
@@ -59,6 +58,7 @@
 #include "aera-visualizer-scene.hpp"
 #include "instantiated-composite-state-item.hpp"
 #include "anchored-horizontal-line.hpp"
+#include "source-formatter.hpp"
 #include "expandable-goal-or-pred-item.hpp"
 
 using namespace std;
@@ -106,12 +106,10 @@ void ExpandableGoalOrPredItem::setFactGoalOrPredFactValueHtml(const QString& pre
   bool valueIsDrive = (value->code(0).asOpcode() == Opcodes::Ent);
 
   // Strip the ending confidence value and propagation of saliency threshold.
-  regex saliencyRegex("\\s+[\\w\\:]+\\)$");
-  regex confidenceAndSaliencyRegex("\\s+\\w+\\s+[\\w\\:]+\\)$");
-  string factGoalSource = (goalOrPred ? regex_replace(replicodeObjects_.getSourceCode(getAeraEvent()->object_), confidenceAndSaliencyRegex, ")") : "");
-  string goalOrPredSource = (goalOrPred ? regex_replace(replicodeObjects_.getSourceCode(goalOrPred), saliencyRegex, ")") : "");
-  string factValueSource = regex_replace(replicodeObjects_.getSourceCode(factValue), confidenceAndSaliencyRegex, ")");
-  string valueSource = regex_replace(replicodeObjects_.getSourceCode(value), saliencyRegex, ")");
+  string factGoalSource = (goalOrPred ? SourceFormatter::stripConfidenceAndSaliency(replicodeObjects_.getSourceCode(getAeraEvent()->object_)) : "");
+  string goalOrPredSource = (goalOrPred ? SourceFormatter::stripSaliency(replicodeObjects_.getSourceCode(goalOrPred)) : "");
+  string factValueSource = SourceFormatter::stripConfidenceAndSaliency(replicodeObjects_.getSourceCode(factValue));
+  string valueSource = SourceFormatter::stripSaliency(replicodeObjects_.getSourceCode(value));
 
   QString goalOrPredLabel(goalOrPred ? replicodeObjects_.getLabel(goalOrPred).c_str() : "");
   QString factValueLabel(replicodeObjects_.getLabel(factValue).c_str());
@@ -53,7 +53,6 @@
 
 #include <fstream>
 #include <sstream>
-#include <regex>
 #include <algorithm>
 #include <QRegularExpression>
 #include "explanation-log-window.hpp"
@@ -61,6 +60,8 @@
 #include "model-item.hpp"
 #include "composite-state-item.hpp"
 #include "../submodules/AERA/r_comp/preprocessor.h"
+#include "source-formatter.hpp"
+#include "variable-binder.hpp"
 #include "instantiated-composite-state-item.hpp"
 
 using namespace std;
@@ -82,7 +83,7 @@ InstantiatedCompositeStateItem::InstantiatedCompositeStateItem(
     " " + RightDoubleArrowHtml + "<br>&nbsp;&nbsp;Instantiated Comp. State"),
   newInstantiatedCompositeStateEvent_(newInstantiatedCompositeStateEvent), showState_(HIDE_ICST)
 {
-  setFactIcstHtml();
+  // makeHtml() sets factIcstHtml_ when the user first expands the item.
   setBoundCstAndMembersHtml();
   setTextItemAndPolygon(makeHtml(), true);
 }
@@ -117,19 +118,16 @@ void InstantiatedCompositeStateItem::setFactIcstHtml()
   auto icst = newInstantiatedCompositeStateEvent_->object_->get_reference(0);
 
   // Strip the ending confidence value and propagation of saliency threshold.
-  regex saliencyRegex("\\s+[\\w\\:]+\\)$");
-  regex confidenceAndSaliencyRegex("\\s+\\w+\\s+[\\w\\:]+\\)$");
-  string factIcstSource = regex_replace(
-    replicodeObjects_.getSourceCode(newInstantiatedCompositeStateEvent_->object_), confidenceAndSaliencyRegex, ")");
-  string icstSource = regex_replace(replicodeObjects_.getSourceCode(icst), saliencyRegex, ")");
+  string factIcstSource = SourceFormatter::stripConfidenceAndSaliency(
+    replicodeObjects_.getSourceCode(newInstantiatedCompositeStateEvent_->object_));
+  string icstSource = SourceFormatter::stripSaliency(replicodeObjects_.getSourceCode(icst));
 
   QString icstLabel(replicodeObjects_.getLabel(icst).c_str());
 
   factIcstHtml_ = QString(factIcstSource.c_str()).replace(icstLabel, DownArrowHtml);
   factIcstHtml_ += QString("\n      ") + icstSource.c_str();
 
-  addSourceCodeHtmlLinks(icst, factIcstHtml_);
-  factIcstHtml_ = htmlify(factIcstHtml_);
+  factIcstHtml_ = htmlifyWithLinks(icst, factIcstHtml_);
 }
 
 void InstantiatedCompositeStateItem::setBoundCstAndMembersHtml()
@@ -149,56 +147,24 @@ void InstantiatedCompositeStateItem::setBoundCstAndMembersHtml()
     // We don't expect this.
     return;
 
-  string cstSource = CompositeStateItem::simplifyCstSource(replicodeObjects_.getSourceCode(cst));
+  string cstSource = SourceFormatter::simplifyCstSource(replicodeObjects_.getSourceCode(cst));
   // Get just the set of members, which start on the second line and are indented by three spaces.
-  string cstMembersSource;
-  auto match = QRegularExpression("^.+\\n((   .+\\n)+)").match(cstSource.c_str());
-  if (match.hasMatch())
-    // Strip the ending \n .
-    cstMembersSource = match.captured(1).mid(0, match.captured(1).size() - 1).toStdString();
-
-  // Substitute variables.
-  int iVariable = -1;
-  size_t iTemplateValues = 0;
-  size_t iExposedValues = 0;
-  while (iTemplateValues < templateValues.size() || iExposedValues < exposedValues.size()) {
-    // v0, v1, v2, etc. are split between templateValues and exposedValues.
-    QString boundValue = (iTemplateValues < templateValues.size() ? 
-      templateValues[iTemplateValues] : exposedValues[iExposedValues]);
-
-    ++iVariable;
-    if (iVariable == iAfterVariable)
-      ++iVariable;
-    if (iVariable == iBeforeVariable)
-      ++iVariable;
-
-    string variable = "v" + to_string(iVariable) + ":";
-    cstSource = regex_replace(cstSource, regex(variable), variable + boundValue.toStdString());
-    // For boundCstMemberHtml_, don't include the variable.
-    cstMembersSource = regex_replace(cstMembersSource, regex(variable), boundValue.toStdString());
-
-    if (iTemplateValues < templateValues.size())
-      // Still looking at templateValues.
-      ++iTemplateValues;
-    else
-      ++iExposedValues;
-  }
+  string cstMembersSource = SourceFormatter::getCstMembersSource(cstSource);
 
-  auto afterVariable = "v" + to_string(iAfterVariable) + ":";
-  auto beforeVariable = "v" + to_string(iBeforeVariable) + ":";
-  cstSource = regex_replace(cstSource, regex(afterVariable), replicodeObjects_.relativeTime(factIcst->get_after()));
-  cstSource = regex_replace(cstSource, regex(beforeVariable), replicodeObjects_.relativeTime(factIcst->get_before()));
-  cstMembersSource = regex_replace(cstMembersSource, regex(afterVariable), replicodeObjects_.relativeTime(factIcst->get_after()));
-  cstMembersSource = regex_replace(cstMembersSource, regex(beforeVariable), replicodeObjects_.relativeTime(factIcst->get_before()));
+  // Substitute variables and replace the timing variables with the timings.
+  VariableBinder binder(templateValues, exposedValues, iAfterVariable, iBeforeVariable);
+  binder.setReplacement(iAfterVariable, replicodeObjects_.relativeTime(factIcst->get_after()));
+  binder.setReplacement(iBeforeVariable, replicodeObjects_.relativeTime(factIcst->get_before()));
+  cstSource = binder.bind(cstSource, true);
+  // For boundCstMemberHtml_, don't include the variable.
+  cstMembersSource = binder.bind(cstMembersSource, false);
 
   boundCstHtml_ = cstSource.c_str();
-  addSourceCodeHtmlLinks(cst, boundCstHtml_);
-  boundCstHtml_ = htmlify(boundCstHtml_);
-  ModelItem::highlightVariables(boundCstHtml_);
+  boundCstHtml_ = htmlifyWithLinks(cst, boundCstHtml_);
+  SourceFormatter::highlightVariables(boundCstHtml_);
 
   boundCstMembersHtml_ = cstMembersSource.c_str();
-  addSourceCodeHtmlLinks(cst, boundCstMembersHtml_);
-  boundCstMembersHtml_ = htmlify(boundCstMembersHtml_);
+  boundCstMembersHtml_ = htmlifyWithLinks(cst, boundCstMembersHtml_);
 }
 
 QString InstantiatedCompositeStateItem::makeIcstMembersSource(
@@ -218,10 +184,11 @@ QString InstantiatedCompositeStateItem::makeIcstMembersSource(
     // We don't expect this.
     return "";
 
-  string cstSource = CompositeStateItem::simplifyCstSource(replicodeObjects.getSourceCode(cst));
+  string cstSource = SourceFormatter::simplifyCstSource(replicodeObjects.getSourceCode(cst));
   // Get just the members, which are indented by three spaces. Get the value inside the (fact value ...).
   string cstMembersSource;
-  auto i = QRegularExpression("   \\((\\|?fact) (\\([^\\n]+)\\n").globalMatch(cstSource.c_str());
+  static const QRegularExpression memberRegex("   \\((\\|?fact) (\\([^\\n]+)\\n");
+  auto i = memberRegex.globalMatch(cstSource.c_str());
   while (i.hasNext()) {
     auto match = i.next();
     auto value = match.captured(2);
@@ -237,33 +204,8 @@ QString InstantiatedCompositeStateItem::makeIcstMembersSource(
   }
 
   // Substitute variables.
-  int iVariable = -1;
-  size_t iTemplateValues = 0;
-  size_t iExposedValues = 0;
-  while (iTemplateValues < templateValues.size() || iExposedValues < exposedValues.size()) {
-    // v0, v1, v2, etc. are split between templateValues and exposedValues.
-    QString boundValue = (iTemplateValues < templateValues.size() ?
-      templateValues[iTemplateValues] : exposedValues[iExposedValues]);
-
-    ++iVariable;
-    if (iVariable == iAfterVariable)
-      ++iVariable;
-    if (iVariable == iBeforeVariable)
-      ++iVariable;
-
-    string variable = "v" + to_string(iVariable) + ":";
-    cstSource = regex_replace(cstSource, regex(variable), variable + boundValue.toStdString());
-    // For boundCstMemberHtml_, don't include the variable.
-    cstMembersSource = regex_replace(cstMembersSource, regex(variable), boundValue.toStdString());
-
-    if (iTemplateValues < templateValues.size())
-      // Still looking at templateValues.
-      ++iTemplateValues;
-    else
-      ++iExposedValues;
-  }
-
-  return QString(cstMembersSource.c_str());
+  VariableBinder binder(templateValues, exposedValues, iAfterVariable, iBeforeVariable);
+  return QString(binder.bind(cstMembersSource, false).c_str());
 }
 
 QString InstantiatedCompositeStateItem::makeHtml()
@@ -277,6 +219,8 @@ QString InstantiatedCompositeStateItem::makeHtml()
   else {
     html += "<a href=\"#hide-icst\">" + UnselectedRadioButtonHtml + " Hide icst</a>" +
       " " + SelectedRadioButtonHtml + " What Made This?";
+    if (factIcstHtml_.isNull())
+      setFactIcstHtml();
 
     auto factIcst = newInstantiatedCompositeStateEvent_->object_;
     auto icst = factIcst->get_reference(0);
@@ -52,12 +52,12 @@
 //_/_/ 
 //_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 
-#include <regex>
 #include "aera-visualizer-window.hpp"
 #include "instantiated-model-item.hpp"
 #include <QMenu>
 #include "explanation-log-window.hpp"
 #include "aera-visualizer-scene.hpp"
+#include "source-formatter.hpp"
 
 using namespace std;
 using namespace r_code;
@@ -78,12 +78,8 @@ ImdlItem::ImdlItem(
 {
   // Extract the 2nd set of bracketed valuesfrom an expression of the form
   //    (imdl mdl_74 [10 0s:300ms:0us 0s:400ms:0us] [b v4: v5: v6: v7:] : :)
-  smatch matches;
-  regex templateValsRegex("\\[[\\w\\s\\.:-]*\\] (\\[[\\w\\s\\.:-]*\\])");
-  std::string sourceCode = replicodeObjects_.getSourceCode(imdl_->imdl_);
-  if (regex_search(sourceCode, matches, templateValsRegex)) {
-    templateVals_ = QString::fromStdString(matches[1].str());
-  }
+  templateVals_ = QString::fromStdString(
+    SourceFormatter::getSecondBracketedValues(replicodeObjects_.getSourceCode(imdl_->imdl_)));
 
   // Build the explanation HTML
   explanation_ = "Input " + makeHtmlLink(imdl_->getCause(), replicodeObjects_) + " matched the LHS of model " +
@@ -51,11 +51,11 @@
 //_/_/ 
 //_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 
-#include <regex>
 #include <QMenu>
 #include "explanation-log-window.hpp"
 #include "../aera-visualizer-window.hpp"
 #include "aera-visualizer-scene.hpp"
+#include "source-formatter.hpp"
 #include "io-device-inject-eject-item.hpp"
 
 using namespace std;
@@ -75,24 +75,16 @@ IoDeviceInjectEjectItem::IoDeviceInjectEjectItem(
   setLabelHtml();
   setFactValHtml();
 
-  // Set up the textItem_ first to get its size.
-  if (textItem_)
-    delete textItem_;
-  textItem_ = new TextItem(this);
-  textItem_->setHtml(labelHtml_);
-  // adjustSize() is needed for right-aligned text.
-  textItem_->adjustSize();
+  // Set up the text first to get its size. If the item is dehydrated, this only measures it.
+  QSizeF textSize = setTextHtml(labelHtml_);
 
   // Position the item origin on the arrow.
   qreal left = -4;
-  qreal top = -textItem_->boundingRect().height() / 2 + 5;
-  textItem_->setPos(left -5, top - 5);
-  textItem_->setTextInteractionFlags(Qt::TextBrowserInteraction);
-  QObject::connect(textItem_, &QGraphicsTextItem::linkActivated,
-    [this](const QString& link) { textItemLinkActivated(link); });
+  qreal top = -textSize.height() / 2 + 5;
+  setTextPos(QPointF(left -5, top - 5));
 
-  qreal right = left + textItem_->boundingRect().width() - 5;
-  qreal bottom = textItem_->boundingRect().height() / 2 - 2;
+  qreal right = left + textSize.width() - 5;
+  qreal bottom = textSize.height() / 2 - 2;
 
   // Make a simple rectangle.
   QPainterPath path;
@@ -118,19 +110,16 @@ void IoDeviceInjectEjectItem::setFactValHtml()
   auto val = event_->object_->get_reference(0);
 
   // Strip the ending confidence value and propagation of saliency threshold.
-  regex saliencyRegex("\\s+[\\w\\:]+\\)$");
-  regex confidenceAndSaliencyRegex("\\s+\\w+\\s+[\\w\\:]+\\)$");
-  string factSource = regex_replace(replicodeObjects_.getSourceCode(
-    event_->object_), confidenceAndSaliencyRegex, ")");
-  string valSource = regex_replace(replicodeObjects_.getSourceCode(val), saliencyRegex, ")");
+  string factSource = SourceFormatter::stripConfidenceAndSaliency(replicodeObjects_.getSourceCode(
+    event_->object_));
+  string valSource = SourceFormatter::stripSaliency(replicodeObjects_.getSourceCode(val));
 
   QString valLabel(replicodeObjects_.getLabel(val).c_str());
 
   factValHtml_ = QString(factSource.c_str()).replace(valLabel, DownArrowHtml);
   factValHtml_ += QString("\n      ") + valSource.c_str();
 
-  addSourceCodeHtmlLinks(val, factValHtml_);
-  factValHtml_ = htmlify(factValHtml_);
+  factValHtml_ = htmlifyWithLinks(val, factValHtml_);
 }
 
 void IoDeviceInjectEjectItem::textItemLinkActivated(const QString& link)
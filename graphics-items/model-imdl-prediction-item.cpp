@@ -52,13 +52,13 @@
 //_/_/ 
 //_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 
-#include <regex>
 #include <algorithm>
 #include <QMenu>
 #include "explanation-log-window.hpp"
 #include "aera-visualizer-scene.hpp"
 #include "instantiated-composite-state-item.hpp"
 #include "model-item.hpp"
+#include "source-formatter.hpp"
 #include "model-imdl-prediction-item.hpp"
 
 using namespace std;
@@ -89,12 +89,10 @@ void ModelImdlPredictionItem::setFactPredFactImdlHtml()
   auto imdl = factImdl->get_reference(0);
 
   // Strip the ending confidence value and propagation of saliency threshold.
-  regex saliencyRegex("\\s+[\\w\\:]+\\)$");
-  regex confidenceAndSaliencyRegex("\\s+\\w+\\s+[\\w\\:]+\\)$");
-  string factPredSource = regex_replace(replicodeObjects_.getSourceCode(modelReduction_->object_), confidenceAndSaliencyRegex, ")");
-  string predSource = regex_replace(replicodeObjects_.getSourceCode(pred), saliencyRegex, ")");
-  string factImdlSource = regex_replace(replicodeObjects_.getSourceCode(factImdl), confidenceAndSaliencyRegex, ")");
-  string imdlSource = regex_replace(replicodeObjects_.getSourceCode(imdl), saliencyRegex, ")");
+  string factPredSource = SourceFormatter::stripConfidenceAndSaliency(replicodeObjects_.getSourceCode(modelReduction_->object_));
+  string predSource = SourceFormatter::stripSaliency(replicodeObjects_.getSourceCode(pred));
+  string factImdlSource = SourceFormatter::stripConfidenceAndSaliency(replicodeObjects_.getSourceCode(factImdl));
+  string imdlSource = SourceFormatter::stripSaliency(replicodeObjects_.getSourceCode(imdl));
 
   QString predLabel(replicodeObjects_.getLabel(pred).c_str());
   QString factImdlLabel(replicodeObjects_.getLabel(factImdl).c_str());
@@ -111,8 +109,7 @@ void ModelImdlPredictionItem::setFactPredFactImdlHtml()
   factPredFactImdlHtml_ += "\n                  !imdl-start" + imdlHtml + "!imdl-end";
 
   addSourceCodeHtmlLinks(modelReduction_->object_, factPredFactImdlHtml_);
-  addSourceCodeHtmlLinks(imdl, factPredFactImdlHtml_);
-  factPredFactImdlHtml_ = htmlify(factPredFactImdlHtml_);
+  factPredFactImdlHtml_ = htmlifyWithLinks(imdl, factPredFactImdlHtml_);
 
   highlightedFactPredFactImdlHtml_ = factPredFactImdlHtml_;
   factPredFactImdlHtml_.replace("!factImdl-start", "");
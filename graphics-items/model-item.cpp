@@ -52,7 +52,8 @@
 //_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 
 #include <algorithm>
-#include <QRegularExpression>
+#include "source-formatter.hpp"
+#include "aera-visualizer-scene.hpp"
 #include "model-item.hpp"
 
 using namespace std;
@@ -65,59 +66,26 @@ ModelItem::ModelItem(
   NewModelEvent* newModelEvent, ReplicodeObjects& replicodeObjects, AeraVisualizerScene* parent)
   : AeraGraphicsItem(newModelEvent, replicodeObjects, parent, "Model"),
   newModelEvent_(newModelEvent),
-  strength_(newModelEvent_->object_->code(MDL_STRENGTH).asFloat()),
-  evidenceCount_(newModelEvent_->object_->code(MDL_CNT).asFloat()),
-  successRate_(newModelEvent_->object_->code(MDL_SR).asFloat()),
+  strength_(newModelEvent_->strength_),
+  evidenceCount_(newModelEvent_->evidenceCount_),
+  successRate_(newModelEvent_->successRate_),
   strengthColor_("black"), evidenceCountColor_("black"), successRateColor_("black"),
+  valuesSequence_(0),
   strengthFlashCountdown_(0), evidenceCountFlashCountdown_(0), successRateFlashCountdown_(0)
 {
   // Set up sourceCodeHtml_
-  sourceCodeHtml_ = simplifyModelSource(replicodeObjects_.getSourceCode(newModelEvent_->object_));
-  addSourceCodeHtmlLinks(newModelEvent_->object_, sourceCodeHtml_);
-  highlightLhsAndRhs(sourceCodeHtml_);
-  highlightVariables(sourceCodeHtml_);
-  sourceCodeHtml_ = htmlify(sourceCodeHtml_);
+  auto model = newModelEvent_->object_;
+  sourceCodeHtml_ = replicodeObjects_.getHtmlFragmentCache().get(model, HtmlFragmentCache::MODEL_HTML, [&]() {
+    QString html = SourceFormatter::simplifyModelSource(replicodeObjects_.getSourceCode(model));
+    addSourceCodeHtmlLinks(model, html);
+    SourceFormatter::highlightLhsAndRhs(html);
+    SourceFormatter::highlightVariables(html);
+    return htmlify(html);
+  });
 
   setTextItemAndPolygon(makeHtml(), true);
 }
 
-QString ModelItem::simplifyModelSource(const string& modelSource)
-{
-  QString result = modelSource.c_str();
-  // Strip the set of output groups and parameters.
-  // "[\\s\\n]+" is whitespace "[\\d\\.]+" is a float value.
-  // TODO: The original source may have comments, so need to strip these.
-  result.replace(
-    QRegularExpression("[\\s\\n]+\\[[\\w\\s]+\\]([\\s\\n]+[\\d\\.]+){5}[\\s\\n]*\\)$"), ")");
-
-  // TODO: Correctly remove wildcards.
-  result.replace(QRegularExpression(" : :\\)"), ")");
-  result.replace(QRegularExpression(" :\\)"), ")");
-
-  return result;
-}
-
-void ModelItem::highlightLhsAndRhs(QString& html)
-{
-  // Assume the LHS and RHS are the second and third lines, indented by three spaces.
-  auto match = QRegularExpression("^(.+\\n   )(.+)(\\n   )(.+)").match(html);
-  if (match.hasMatch()) {
-    // match.captured(1) is the first line and indentation of the second line.
-    // match.captured(3) is the indentation of the third line.
-    QString lhs = "<font style=\"background-color:#ffe8e8\">" + match.captured(2) + "</font>";
-    QString rhs = "<font style=\"background-color:#e0ffe0\">" + match.captured(4) + "</font>";
-
-    html = match.captured(1) + lhs + match.captured(3) + rhs + html.mid(match.captured(0).size());
-  }
-}
-
-void ModelItem::highlightVariables(QString& html)
-{
-  // This won't match if a variable is at the beginning of a string, but we don't expect that.
-  // Debug: We also want (\\W) at the end of the regex, but then the match would overlap in "v1 v2".
-  html.replace(QRegularExpression("(\\W)(v\\d+\\:?)"), "\\1<font color=\"#c000c0\">\\2</font>");
-}
-
 bool ModelItem::getTimingVariables(Code* fact, int& iAfterVariable, int& iBeforeVariable)
 {
   if (fact->code(0).asOpcode() != r_exec::Opcodes::Fact ||
@@ -136,28 +104,78 @@ bool ModelItem::getTimingVariables(Code* fact, int& iAfterVariable, int& iBefore
 
 QString ModelItem::makeHtml()
 {
-  auto model = newModelEvent_->object_;
-
   QString html = "";
-  html += "<font style=\"color:" + strengthColor_ + "\">&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;Strength: " +
-    QString::number(strength_) + "</font><br>";
-  html += "<font style=\"color:" + evidenceCountColor_ + "\">Evidence Count: " +
-    QString::number(evidenceCount_) + "</font><br>";
-  html += "<font style=\"color:" + successRateColor_ + "\">&nbsp;&nbsp;&nbsp;&nbsp;Success Rate: " +
-    QString::number(successRate_) + "</font><br>";
-  html += sourceCodeHtml_;
+  auto lines = getValueLines();
+  for (size_t i = 0; i < lines.size(); ++i) {
+    html += "<font style=\"color:" + lines[i].second.name() + "\">" +
+      QString(lines[i].first).replace(QChar::Nbsp, "&nbsp;") + "</font><br>";
+  }
+  // Put the source code in its own block, so that refreshText doesn't lay it out again.
+  html.chop(4);
+  html += "<div>" + sourceCodeHtml_ + "</div>";
   return html;
 }
 
-void ModelItem::updateFromModel()
+vector<pair<QString, QColor> > ModelItem::getValueLines()
 {
-  auto model = newModelEvent_->object_;
-  strengthIncreased_ = (model->code(MDL_STRENGTH).asFloat() >= strength_);
-  strength_ = model->code(MDL_STRENGTH).asFloat();
-  evidenceCountIncreased_ = (model->code(MDL_CNT).asFloat() >= evidenceCount_);
-  evidenceCount_ = model->code(MDL_CNT).asFloat();
-  successRateIncreased_ = (model->code(MDL_SR).asFloat() >= successRate_);
-  successRate_ = model->code(MDL_SR).asFloat();
+  vector<pair<QString, QColor> > lines;
+  lines.push_back(make_pair(QString(11, QChar::Nbsp) + "Strength: " + QString::number(strength_),
+    QColor(strengthColor_)));
+  lines.push_back(make_pair("Evidence Count: " + QString::number(evidenceCount_), QColor(evidenceCountColor_)));
+  lines.push_back(make_pair(QString(4, QChar::Nbsp) + "Success Rate: " + QString::number(successRate_),
+    QColor(successRateColor_)));
+  return lines;
+}
+
+void ModelItem::refreshText()
+{
+  if (textItem_ && textItem_->replaceLinesToEndOfBlock("Strength: ", getValueLines()))
+    return;
+
+  // The item is a shell, or a value line is wider than the text. Rebuild the text and the polygon,
+  // which keeps the top-left and updates the arrows.
+  setTextItemAndPolygon(makeHtml(), true);
+}
+
+void ModelItem::setStrengthFlashCountdown(int countdown)
+{
+  strengthFlashCountdown_ = countdown;
+  if (countdown > 0)
+    parent_->addFlashingItem(this);
+}
+
+void ModelItem::setEvidenceCountFlashCountdown(int countdown)
+{
+  evidenceCountFlashCountdown_ = countdown;
+  if (countdown > 0)
+    parent_->addFlashingItem(this);
+}
+
+void ModelItem::setSuccessRateFlashCountdown(int countdown)
+{
+  successRateFlashCountdown_ = countdown;
+  if (countdown > 0)
+    parent_->addFlashingItem(this);
+}
+
+void ModelItem::updateFromModel(size_t sequence)
+{
+  float32 strength, evidenceCount, successRate;
+  if (!replicodeObjects_.getModelValueHistory().getValues(
+        newModelEvent_->object_, sequence, strength, evidenceCount, successRate)) {
+    // The sequence number is before the NewModelEvent was stepped.
+    strength = newModelEvent_->strength_;
+    evidenceCount = newModelEvent_->evidenceCount_;
+    successRate = newModelEvent_->successRate_;
+  }
+
+  strengthIncreased_ = (strength >= strength_);
+  strength_ = strength;
+  evidenceCountIncreased_ = (evidenceCount >= evidenceCount_);
+  evidenceCount_ = evidenceCount;
+  successRateIncreased_ = (successRate >= successRate_);
+  successRate_ = successRate;
+  valuesSequence_ = sequence;
 
   refreshText();
 }
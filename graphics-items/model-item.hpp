@@ -69,48 +69,49 @@ public:
   ModelItem(
     NewModelEvent* newModelEvent, ReplicodeObjects& replicodeObjects, AeraVisualizerScene* parent);
 
-  void updateFromModel();
+  /**
+   * Set the shown strength, evidence count and success rate to the values of the model after
+   * the given sequence number from the ModelValueHistory, and set the flags for which values
+   * increased. If the history has no values for the model up to the sequence number, show the
+   * values of the NewModelEvent.
+   * \param sequence The sequence number of the values to show, which is the count of stepped events.
+   */
+  void updateFromModel(size_t sequence);
+
+  core::float32 getStrength() const { return strength_; }
+  core::float32 getEvidenceCount() const { return evidenceCount_; }
+  core::float32 getSuccessRate() const { return successRate_; }
+
+  /**
+   * Get the sequence number of the model values which are shown, as given to updateFromModel
+   * (or 0 for the values of the NewModelEvent).
+   */
+  size_t getValuesSequence() const { return valuesSequence_; }
 
   void setStrengthColor(QString color)
   {
+    if (strengthColor_ == color)
+      return;
     strengthColor_ = color;
     refreshText();
   };
 
   void setEvidenceCountColor(QString color) 
   { 
+    if (evidenceCountColor_ == color)
+      return;
     evidenceCountColor_ = color;
     refreshText();
   };
 
   void setSuccessRateColor(QString color)
   {
+    if (successRateColor_ == color)
+      return;
     successRateColor_ = color;
     refreshText();
   };
 
-  /**
-   * Start with the source from replicodeObjects_.getSourceCode for a model, and
-   * remove the set of output groups and parameters, and remove trailing wildcards, and
-   * replace a template variable with a wildcard if it is also assigned.
-   * \param modelSource The source from replicodeObjects_.getSourceCode.
-   * \return The simplified source code
-   */
-  static QString simplifyModelSource(const std::string& modelSource);
-
-  /**
-   * Assume the html is a model with \n line endings, and highlight the left-hand-side
-   * and right-hand-side expressions with red and green background.s
-   * \param html The model HTML string to modify.
-   */
-  static void highlightLhsAndRhs(QString& html);
-
-  /**
-   * Modify the HTML string to change the font color of variables.
-   * \param html The HTML string to modify.
-   */
-  static void highlightVariables(QString& html);
-
   /**
    * Check that the timings are variables and return the variable indexes.
    * \param fact The Fact with the timings.
@@ -123,6 +124,24 @@ public:
    */
   static bool getTimingVariables(r_code::Code* fact, int& iAfterVariable, int& iBeforeVariable);
 
+  /**
+   * Set strengthFlashCountdown_ and add this item to the flashing items of the parent scene.
+   * \param countdown The new countdown, usually AeraVisualizerScene::FLASH_COUNT.
+   */
+  void setStrengthFlashCountdown(int countdown);
+
+  /**
+   * Set evidenceCountFlashCountdown_ and add this item to the flashing items of the parent scene.
+   * \param countdown The new countdown, usually AeraVisualizerScene::FLASH_COUNT.
+   */
+  void setEvidenceCountFlashCountdown(int countdown);
+
+  /**
+   * Set successRateFlashCountdown_ and add this item to the flashing items of the parent scene.
+   * \param countdown The new countdown, usually AeraVisualizerScene::FLASH_COUNT.
+   */
+  void setSuccessRateFlashCountdown(int countdown);
+
   int strengthFlashCountdown_;
   bool strengthIncreased_;
   int evidenceCountFlashCountdown_;
@@ -134,17 +153,18 @@ private:
   QString makeHtml();
 
   /**
-   * Set textItem_ to headerHtml_ + makeHtml().
+   * Get the strength, evidence count and success rate lines, padded with non-breaking spaces to
+   * align the colons, and the color of each line.
+   * \return The lines and their colors.
    */
-  void refreshText()
-  {
-    auto html = makeHtml();
-    textItem_->setHtml(html);
-    // adjustSize() is needed for right-aligned text.
-    textItem_->adjustSize();
-    textItem_->setHtml(headerHtml_ + html);
-    textItem_->adjustSize();
-  }
+  std::vector<std::pair<QString, QColor> > getValueLines();
+
+  /**
+   * Replace the value lines in the textItem_. makeHtml() puts the source code in a separate
+   * block, so this only lays out and repaints the block of the value lines. If the values don't
+   * fit, set textItem_ to headerHtml_ + makeHtml().
+   */
+  void refreshText();
 
   NewModelEvent* newModelEvent_;
   QString sourceCodeHtml_;
@@ -154,6 +174,7 @@ private:
   QString evidenceCountColor_;
   core::float32 successRate_;
   QString successRateColor_;
+  size_t valuesSequence_;
 };
 
 }
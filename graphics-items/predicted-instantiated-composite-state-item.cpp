@@ -51,14 +51,14 @@
 //_/_/ 
 //_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 
-#include <regex>
 #include <algorithm>
-#include <QRegularExpression>
 #include "explanation-log-window.hpp"
 #include "aera-visualizer-scene.hpp"
 #include "model-item.hpp"
 #include "composite-state-item.hpp"
 #include "instantiated-composite-state-item.hpp"
+#include "source-formatter.hpp"
+#include "variable-binder.hpp"
 #include "predicted-instantiated-composite-state-item.hpp"
 
 using namespace std;
@@ -79,7 +79,7 @@ PredictedInstantiatedCompositeStateItem::PredictedInstantiatedCompositeStateItem
     " " + RightDoubleArrowHtml + "<br>&nbsp;&nbsp;Pred. Instantiated Comp. State"),
   newInstantiatedCompositeStateEvent_(newInstantiatedCompositeStateEvent), showState_(HIDE_ICST)
 {
-  setFactIcstHtml();
+  // makeHtml() sets factIcstHtml_ when the user first expands the item.
   setBoundCstAndMembersHtml();
   setTextItemAndPolygon(makeHtml(), true);
 }
@@ -92,19 +92,16 @@ void PredictedInstantiatedCompositeStateItem::setFactIcstHtml()
   auto icst = factIcst->get_reference(0);
 
   // Strip the ending confidence value and propagation of saliency threshold.
-  regex saliencyRegex("\\s+[\\w\\:]+\\)$");
-  regex confidenceAndSaliencyRegex("\\s+\\w+\\s+[\\w\\:]+\\)$");
-  string factIcstSource = regex_replace(
-    replicodeObjects_.getSourceCode(factIcst), confidenceAndSaliencyRegex, ")");
-  string icstSource = regex_replace(replicodeObjects_.getSourceCode(icst), saliencyRegex, ")");
+  string factIcstSource = SourceFormatter::stripConfidenceAndSaliency(
+    replicodeObjects_.getSourceCode(factIcst));
+  string icstSource = SourceFormatter::stripSaliency(replicodeObjects_.getSourceCode(icst));
 
   QString icstLabel(replicodeObjects_.getLabel(icst).c_str());
 
   factIcstHtml_ = QString(factIcstSource.c_str()).replace(icstLabel, DownArrowHtml);
   factIcstHtml_ += QString("\n      ") + icstSource.c_str();
 
-  addSourceCodeHtmlLinks(icst, factIcstHtml_);
-  factIcstHtml_ = htmlify(factIcstHtml_);
+  factIcstHtml_ = htmlifyWithLinks(icst, factIcstHtml_);
 }
 
 void PredictedInstantiatedCompositeStateItem::setBoundCstAndMembersHtml()
@@ -126,56 +123,24 @@ void PredictedInstantiatedCompositeStateItem::setBoundCstAndMembersHtml()
     // We don't expect this.
     return;
 
-  string cstSource = CompositeStateItem::simplifyCstSource(replicodeObjects_.getSourceCode(cst));
+  string cstSource = SourceFormatter::simplifyCstSource(replicodeObjects_.getSourceCode(cst));
   // Get just the set of members, which start on the second line and are indented by three spaces.
-  string cstMembersSource;
-  auto match = QRegularExpression("^.+\\n((   .+\\n)+)").match(cstSource.c_str());
-  if (match.hasMatch())
-    // Strip the ending \n .
-    cstMembersSource = match.captured(1).mid(0, match.captured(1).size() - 1).toStdString();
-
-  // Substitute variables.
-  int iVariable = -1;
-  size_t iTemplateValues = 0;
-  size_t iExposedValues = 0;
-  while (iTemplateValues < templateValues.size() || iExposedValues < exposedValues.size()) {
-    // v0, v1, v2, etc. are split between templateValues and exposedValues.
-    QString boundValue = (iTemplateValues < templateValues.size() ? 
-      templateValues[iTemplateValues] : exposedValues[iExposedValues]);
-
-    ++iVariable;
-    if (iVariable == iAfterVariable)
-      ++iVariable;
-    if (iVariable == iBeforeVariable)
-      ++iVariable;
-
-    string variable = "v" + to_string(iVariable) + ":";
-    cstSource = regex_replace(cstSource, regex(variable), variable + boundValue.toStdString());
-    // For boundCstMemberHtml_, don't include the variable.
-    cstMembersSource = regex_replace(cstMembersSource, regex(variable), boundValue.toStdString());
-
-    if (iTemplateValues < templateValues.size())
-      // Still looking at templateValues.
-      ++iTemplateValues;
-    else
-      ++iExposedValues;
-  }
+  string cstMembersSource = SourceFormatter::getCstMembersSource(cstSource);
 
-  auto afterVariable = "v" + to_string(iAfterVariable) + ":";
-  auto beforeVariable = "v" + to_string(iBeforeVariable) + ":";
-  cstSource = regex_replace(cstSource, regex(afterVariable), replicodeObjects_.relativeTime(factIcst->get_after()));
-  cstSource = regex_replace(cstSource, regex(beforeVariable), replicodeObjects_.relativeTime(factIcst->get_before()));
-  cstMembersSource = regex_replace(cstMembersSource, regex(afterVariable), replicodeObjects_.relativeTime(factIcst->get_after()));
-  cstMembersSource = regex_replace(cstMembersSource, regex(beforeVariable), replicodeObjects_.relativeTime(factIcst->get_before()));
+  // Substitute variables and replace the timing variables with the timings.
+  VariableBinder binder(templateValues, exposedValues, iAfterVariable, iBeforeVariable);
+  binder.setReplacement(iAfterVariable, replicodeObjects_.relativeTime(factIcst->get_after()));
+  binder.setReplacement(iBeforeVariable, replicodeObjects_.relativeTime(factIcst->get_before()));
+  cstSource = binder.bind(cstSource, true);
+  // For boundCstMemberHtml_, don't include the variable.
+  cstMembersSource = binder.bind(cstMembersSource, false);
 
   boundCstHtml_ = cstSource.c_str();
-  addSourceCodeHtmlLinks(cst, boundCstHtml_);
-  boundCstHtml_ = htmlify(boundCstHtml_);
-  ModelItem::highlightVariables(boundCstHtml_);
+  boundCstHtml_ = htmlifyWithLinks(cst, boundCstHtml_);
+  SourceFormatter::highlightVariables(boundCstHtml_);
 
   boundCstMembersHtml_ = cstMembersSource.c_str();
-  addSourceCodeHtmlLinks(cst, boundCstMembersHtml_);
-  boundCstMembersHtml_ = htmlify(boundCstMembersHtml_);
+  boundCstMembersHtml_ = htmlifyWithLinks(cst, boundCstMembersHtml_);
 }
 
 QString PredictedInstantiatedCompositeStateItem::makeHtml()
@@ -189,6 +154,8 @@ QString PredictedInstantiatedCompositeStateItem::makeHtml()
   else {
     html += "<a href=\"#hide-icst\">" + UnselectedRadioButtonHtml + " Hide icst</a>" +
       " " + SelectedRadioButtonHtml + " What Made This?";
+    if (factIcstHtml_.isNull())
+      setFactIcstHtml();
 
     auto factPredFactIcst = (_Fact*)newInstantiatedCompositeStateEvent_->object_;
     auto predFactIcst = ((_Fact*)newInstantiatedCompositeStateEvent_->object_)->get_pred();
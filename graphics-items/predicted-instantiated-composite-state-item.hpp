@@ -78,6 +78,7 @@ private:
 
   /**
    * Set factIcstHtml_ to the HTML source code for the fact and icst from newInstantiatedCompositeStateEvent_->object_.
+   * makeHtml() calls this when the user first selects "What Made This?".
    */
   void setFactIcstHtml();
 
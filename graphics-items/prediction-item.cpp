@@ -52,13 +52,14 @@
 //_/_/ 
 //_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 
-#include <regex>
 #include <algorithm>
 #include <QMenu>
 #include "explanation-log-window.hpp"
 #include "aera-visualizer-scene.hpp"
 #include "instantiated-composite-state-item.hpp"
 #include "model-item.hpp"
+#include "source-formatter.hpp"
+#include "variable-binder.hpp"
 #include "prediction-item.hpp"
 
 using namespace std;
@@ -78,9 +79,8 @@ PredictionItem::PredictionItem(
     " " + RightDoubleArrowHtml + "<br>&nbsp;&nbsp;Prediction"),
   modelReduction_(modelReduction), showState_(HIDE_IMDL)
 {
+  // makeHtml() sets factImdlHtml_ and the model HTML when the user first expands the item.
   setFactPredFactMkValHtml();
-  setFactImdlHtml();
-  setBoundAndUnboundModelHtml();
   setTextItemAndPolygon(makeHtml(), true);
 }
 
@@ -91,12 +91,10 @@ void PredictionItem::setFactPredFactMkValHtml()
   auto mkVal = factMkVal->get_reference(0);
 
   // Strip the ending confidence value and propagation of saliency threshold.
-  regex saliencyRegex("\\s+[\\w\\:]+\\)$");
-  regex confidenceAndSaliencyRegex("\\s+\\w+\\s+[\\w\\:]+\\)$");
-  string factPredSource = regex_replace(replicodeObjects_.getSourceCode(modelReduction_->object_), confidenceAndSaliencyRegex, ")");
-  string predSource = regex_replace(replicodeObjects_.getSourceCode(pred), saliencyRegex, ")");
-  string factMkValSource = regex_replace(replicodeObjects_.getSourceCode(factMkVal), confidenceAndSaliencyRegex, ")");
-  string mkValSource = regex_replace(replicodeObjects_.getSourceCode(mkVal), saliencyRegex, ")");
+  string factPredSource = SourceFormatter::stripConfidenceAndSaliency(replicodeObjects_.getSourceCode(modelReduction_->object_));
+  string predSource = SourceFormatter::stripSaliency(replicodeObjects_.getSourceCode(pred));
+  string factMkValSource = SourceFormatter::stripConfidenceAndSaliency(replicodeObjects_.getSourceCode(factMkVal));
+  string mkValSource = SourceFormatter::stripSaliency(replicodeObjects_.getSourceCode(mkVal));
 
   QString predLabel(replicodeObjects_.getLabel(pred).c_str());
   QString factMkValLabel(replicodeObjects_.getLabel(factMkVal).c_str());
@@ -112,8 +110,7 @@ void PredictionItem::setFactPredFactMkValHtml()
   factPredFactMkValHtml_ += "\n              !factMkVal-start" + factMkValHtml + "!factMkVal-end";
   factPredFactMkValHtml_ += "\n                  !mkVal-start" + mkValHtml + "!mkVal-end";
 
-  addSourceCodeHtmlLinks(modelReduction_->object_, factPredFactMkValHtml_);
-  factPredFactMkValHtml_ = htmlify(factPredFactMkValHtml_);
+  factPredFactMkValHtml_ = htmlifyWithLinks(modelReduction_->object_, factPredFactMkValHtml_);
 
   highlightedFactPredFactMkValHtml_ = factPredFactMkValHtml_;
   factPredFactMkValHtml_.replace("!factMkVal-start", "");
@@ -133,26 +130,23 @@ void PredictionItem::setFactImdlHtml()
   auto imdl = modelReduction_->getFactImdl()->get_reference(0);
 
   // Strip the ending confidence value and propagation of saliency threshold.
-  regex saliencyRegex("\\s+[\\w\\:]+\\)$");
-  regex confidenceAndSaliencyRegex("\\s+\\w+\\s+[\\w\\:]+\\)$");
-  string factImdlSource = regex_replace(
-    replicodeObjects_.getSourceCode(modelReduction_->getFactImdl()), confidenceAndSaliencyRegex, ")");
-  string imdlSource = regex_replace(replicodeObjects_.getSourceCode(imdl), saliencyRegex, ")");
+  string factImdlSource = SourceFormatter::stripConfidenceAndSaliency(
+    replicodeObjects_.getSourceCode(modelReduction_->getFactImdl()));
+  string imdlSource = SourceFormatter::stripSaliency(replicodeObjects_.getSourceCode(imdl));
 
   // Find the set of template values.
-  regex templateRegex("^(\\(imdl \\w+ )(\\[[^\\]]+\\])( .+)$");
-  smatch matches;
-  if (regex_search(imdlSource, matches, templateRegex))
+  size_t templateStart, templateLength;
+  if (SourceFormatter::findImdlTemplateValues(imdlSource, templateStart, templateLength))
     // Add the link for the template values.
-    imdlSource = matches[1].str() + "<a href=\"#imdl-template-values\">" + matches[2].str() + "</a>" + matches[3].str();
+    imdlSource = imdlSource.substr(0, templateStart) + "<a href=\"#imdl-template-values\">" +
+      imdlSource.substr(templateStart, templateLength) + "</a>" + imdlSource.substr(templateStart + templateLength);
 
   QString imdlLabel(replicodeObjects_.getLabel(imdl).c_str());
 
   factImdlHtml_ = QString(factImdlSource.c_str()).replace(imdlLabel, DownArrowHtml);
   factImdlHtml_ += QString("\n      ") + imdlSource.c_str();
 
-  addSourceCodeHtmlLinks(imdl, factImdlHtml_);
-  factImdlHtml_ = htmlify(factImdlHtml_);
+  factImdlHtml_ = htmlifyWithLinks(imdl, factImdlHtml_);
 }
 
 void PredictionItem::setBoundAndUnboundModelHtml()
@@ -171,59 +165,30 @@ void PredictionItem::setBoundAndUnboundModelHtml()
     // We don't expect this.
     return;
 
-  QString unboundModelSource = ModelItem::simplifyModelSource(replicodeObjects_.getSourceCode(mdl));
-  ModelItem::highlightLhsAndRhs(unboundModelSource);
+  auto& htmlFragmentCache = replicodeObjects_.getHtmlFragmentCache();
+  QString unboundModelSource = htmlFragmentCache.get(mdl, HtmlFragmentCache::LHS_RHS_MODEL_SOURCE, [&]() {
+    QString source = SourceFormatter::simplifyModelSource(replicodeObjects_.getSourceCode(mdl));
+    SourceFormatter::highlightLhsAndRhs(source);
+    return source;
+  });
   string modelSource = unboundModelSource.toStdString();
-  // Temporarily replace \n with \x01 so that we match the entire string, not by line.
-  replace(modelSource.begin(), modelSource.end(), '\n', '\x01');
-
-  // Temporarily change the assignment variables so that they are not substituted.
-  modelSource = regex_replace(modelSource, regex("\\x01   v"), "\x01   !");
 
   // Replace backward guards with an empty set.
-  modelSource = regex_replace(modelSource, regex("\\x01\\[\\](\\x01   [^\\x01]+)+$"), "\x01|[])");
-
-  // Substitute variables.
-  // TODO: Share code with InstantiatedCompositeStateItem::setBoundCstAndMembersHtml()?
-  int iVariable = -1;
-  size_t iTemplateValues = 0;
-  size_t iExposedValues = 0;
-  while (iTemplateValues < templateValues.size() || iExposedValues < exposedValues.size()) {
-    // v0, v1, v2, etc. are split between templateValues and exposedValues.
-    QString boundValue = (iTemplateValues < templateValues.size() ?
-      templateValues[iTemplateValues] : exposedValues[iExposedValues]);
-
-    ++iVariable;
-    if (iVariable == iAfterVariable)
-      ++iVariable;
-    if (iVariable == iBeforeVariable)
-      ++iVariable;
-
-    string variable = "v" + to_string(iVariable) + ":";
-    modelSource = regex_replace(modelSource, regex(variable), variable + boundValue.toStdString());
-
-    if (iTemplateValues < templateValues.size())
-      // Still looking at templateValues.
-      ++iTemplateValues;
-    else
-      ++iExposedValues;
-  }
+  SourceFormatter::clearBackwardGuards(modelSource);
 
-  // Restore assignment variables.
-  modelSource = regex_replace(modelSource, regex("\\x01   !"), "\x01   v");
-  // Restore \n.
-  replace(modelSource.begin(), modelSource.end(), '\x01', '\n');
+  // Substitute variables, except the assignment variables.
+  VariableBinder binder(templateValues, exposedValues, iAfterVariable, iBeforeVariable);
+  modelSource = binder.bind(modelSource, true, true);
 
-  unboundModelHtml_ = unboundModelSource;
-  addSourceCodeHtmlLinks(mdl, unboundModelHtml_);
-  unboundModelHtml_ = htmlify(unboundModelHtml_);
+  unboundModelHtml_ = htmlFragmentCache.get(mdl, HtmlFragmentCache::UNBOUND_MODEL_HTML, [&]() {
+    QString html = htmlifyWithLinks(mdl, unboundModelSource);
+    SourceFormatter::highlightVariables(html);
+    return html;
+  });
 
   boundModelHtml_ = modelSource.c_str();
-  addSourceCodeHtmlLinks(mdl, boundModelHtml_);
-  boundModelHtml_ = htmlify(boundModelHtml_);
-
-  ModelItem::highlightVariables(boundModelHtml_);
-  ModelItem::highlightVariables(unboundModelHtml_);
+  boundModelHtml_ = htmlifyWithLinks(mdl, boundModelHtml_);
+  SourceFormatter::highlightVariables(boundModelHtml_);
 }
 
 QString PredictionItem::makeHtml()
@@ -242,6 +207,11 @@ QString PredictionItem::makeHtml()
         " <a href=\"#what-made-this\">" + UnselectedRadioButtonHtml + " What Made This?</a>" +
         " " + SelectedRadioButtonHtml + " Show Model";
 
+    if (factImdlHtml_.isNull()) {
+      setFactImdlHtml();
+      setBoundAndUnboundModelHtml();
+    }
+
     auto imdl = modelReduction_->getFactImdl()->get_reference(0);
     auto mdl = imdl->get_reference(0);
     html += "<br>Input " + makeHtmlLink(modelReduction_->getCause()) +
@@ -294,12 +264,10 @@ void PredictionItem::textItemLinkActivated(const QString& link)
     QString imdlLabel = replicodeObjects_.getLabel(imdl).c_str();
 
     // Strip the ending confidence value and propagation of saliency threshold.
-    regex saliencyRegex("\\s+[\\w\\:]+\\)$");
-    regex confidenceAndSaliencyRegex("\\s+[\\w\\:]\\s+[\\w\\:]+\\)$");
-    string factPredSource = regex_replace(replicodeObjects_.getSourceCode(requirementFactPred), confidenceAndSaliencyRegex, ")");
-    string predSource = regex_replace(replicodeObjects_.getSourceCode(requirementPred), saliencyRegex, ")");
-    string factImdlSource = regex_replace(replicodeObjects_.getSourceCode(factImdl), confidenceAndSaliencyRegex, ")");
-    string imdlSource = regex_replace(replicodeObjects_.getSourceCode(imdl), confidenceAndSaliencyRegex, ")");
+    string factPredSource = SourceFormatter::stripShortConfidenceAndSaliency(replicodeObjects_.getSourceCode(requirementFactPred));
+    string predSource = SourceFormatter::stripSaliency(replicodeObjects_.getSourceCode(requirementPred));
+    string factImdlSource = SourceFormatter::stripShortConfidenceAndSaliency(replicodeObjects_.getSourceCode(factImdl));
+    string imdlSource = SourceFormatter::stripShortConfidenceAndSaliency(replicodeObjects_.getSourceCode(imdl));
 
     QString predHtml = QString(predSource.c_str()).replace(factImdlLabel, DownArrowHtml);
     QString factPredHtml = QString(factPredSource.c_str()).replace(predLabel, predHtml);
@@ -309,8 +277,7 @@ void PredictionItem::textItemLinkActivated(const QString& link)
     QString factPredFactImdlHtml = factPredHtml;
     factPredFactImdlHtml += "\n    <font style=\"background-color:#e0ffe0\">" + factImdlHtml + "</font>";
     factPredFactImdlHtml += "\n        <font style=\"background-color:#e0ffe0\">" + imdlHtml + "</font>";
-    addSourceCodeHtmlLinks(imdl, factPredFactImdlHtml);
-    factPredFactImdlHtml = htmlify(factPredFactImdlHtml);
+    factPredFactImdlHtml = htmlifyWithLinks(imdl, factPredFactImdlHtml);
 
     auto menu = new QMenu();
     menu->addAction("What Made This?", [=]() {
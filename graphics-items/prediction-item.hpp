@@ -82,6 +82,7 @@ private:
 
   /**
    * Set factImdlHtml_ to the HTML source code for the fact and imdl from modelReduction_->factImdl_.
+   * makeHtml() calls this and setBoundAndUnboundModelHtml() when the user first expands the item.
    */
   void setFactImdlHtml();
 
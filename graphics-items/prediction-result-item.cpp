@@ -52,12 +52,12 @@
 //_/_/ 
 //_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 
-#include <regex>
 #include <QMenu>
 #include "../submodules/AERA/r_exec/opcodes.h"
 #include "explanation-log-window.hpp"
 #include "aera-visualizer-scene.hpp"
 #include "prediction-item.hpp"
+#include "source-formatter.hpp"
 #include "prediction-result-item.hpp"
 
 using namespace std;
@@ -83,19 +83,16 @@ void PredictionResultItem::setFactOrAntiFactSuccessHtml()
   auto success = predictionResultEvent_->object_->get_reference(0);
 
   // Strip the ending confidence value and propagation of saliency threshold.
-  regex saliencyRegex("\\s+[\\w\\:]+\\)$");
-  regex confidenceAndSaliencyRegex("\\s+\\w+\\s+[\\w\\:]+\\)$");
-  string factOrAntiFactSuccessSource = regex_replace(replicodeObjects_.getSourceCode(
-    predictionResultEvent_->object_), confidenceAndSaliencyRegex, ")");
-  string successSource = regex_replace(replicodeObjects_.getSourceCode(success), saliencyRegex, ")");
+  string factOrAntiFactSuccessSource = SourceFormatter::stripConfidenceAndSaliency(replicodeObjects_.getSourceCode(
+    predictionResultEvent_->object_));
+  string successSource = SourceFormatter::stripSaliency(replicodeObjects_.getSourceCode(success));
 
   QString successLabel(replicodeObjects_.getLabel(success).c_str());
 
   factOrAntiFactSuccessHtml_ = QString(factOrAntiFactSuccessSource.c_str()).replace(successLabel, DownArrowHtml);
   factOrAntiFactSuccessHtml_ += QString("\n      ") + successSource.c_str();
 
-  addSourceCodeHtmlLinks(predictionResultEvent_->object_->get_reference(0), factOrAntiFactSuccessHtml_);
-  factOrAntiFactSuccessHtml_ = htmlify(factOrAntiFactSuccessHtml_);
+  factOrAntiFactSuccessHtml_ = htmlifyWithLinks(predictionResultEvent_->object_->get_reference(0), factOrAntiFactSuccessHtml_);
 }
 
 void PredictionResultItem::textItemLinkActivated(const QString& link)
@@ -52,12 +52,12 @@
 //_/_/ 
 //_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 
-#include <regex>
 #include <algorithm>
 #include <QMenu>
 #include "explanation-log-window.hpp"
 #include "aera-visualizer-scene.hpp"
 #include "program-reduction-item.hpp"
+#include "source-formatter.hpp"
 #include "program-output-fact-item.hpp"
 
 using namespace std;
@@ -81,19 +81,16 @@ void ProgramOutputFactItem::setFactMkValHtml()
   auto mkVal = programReductionNewObjectEvent_->object_->get_reference(0);
 
   // Strip the ending confidence value and propagation of saliency threshold.
-  regex saliencyRegex("\\s+[\\w\\:]+\\)$");
-  regex confidenceAndSaliencyRegex("\\s+\\w+\\s+[\\w\\:]+\\)$");
-  string factMkValSource = regex_replace(replicodeObjects_.getSourceCode(
-    programReductionNewObjectEvent_->object_), confidenceAndSaliencyRegex, ")");
-  string mkValSource = regex_replace(replicodeObjects_.getSourceCode(mkVal), saliencyRegex, ")");
+  string factMkValSource = SourceFormatter::stripConfidenceAndSaliency(replicodeObjects_.getSourceCode(
+    programReductionNewObjectEvent_->object_));
+  string mkValSource = SourceFormatter::stripSaliency(replicodeObjects_.getSourceCode(mkVal));
 
   QString mkValLabel(replicodeObjects_.getLabel(mkVal).c_str());
 
   factMkValHtml_ = QString(factMkValSource.c_str()).replace(mkValLabel, DownArrowHtml);
   factMkValHtml_ += QString("\n      ") + mkValSource.c_str();
 
-  addSourceCodeHtmlLinks(programReductionNewObjectEvent_->object_, factMkValHtml_);
-  factMkValHtml_ = htmlify(factMkValHtml_);
+  factMkValHtml_ = htmlifyWithLinks(programReductionNewObjectEvent_->object_, factMkValHtml_);
 }
 
 void ProgramOutputFactItem::textItemLinkActivated(const QString& link)
@@ -51,8 +51,7 @@
 //_/_/ 
 //_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 
-#include <regex>
-#include <algorithm>
+#include "source-formatter.hpp"
 #include "program-reduction-item.hpp"
 
 using namespace std;
@@ -67,25 +66,17 @@ ProgramReductionItem::ProgramReductionItem(
   programReductionEvent_(programReductionEvent)
 {
   // Set up sourceCodeHtml_
-  sourceCodeHtml_ = simplifyMkRdxSource(replicodeObjects_.getSourceCode(programReductionEvent->object_)).c_str();
-  addSourceCodeHtmlLinks(programReductionEvent_->object_, sourceCodeHtml_);
-  sourceCodeHtml_ = htmlify(sourceCodeHtml_);
+  sourceCodeHtml_ = getMkRdxHtml(programReductionEvent_->object_, replicodeObjects_);
 
   setTextItemAndPolygon(makeHtml(), true);
 }
 
-string ProgramReductionItem::simplifyMkRdxSource(const string& mkRdxSource)
+QString ProgramReductionItem::getMkRdxHtml(Code* mkRdx, const ReplicodeObjects& replicodeObjects)
 {
-  string result = mkRdxSource;
-  // Temporarily replace \n with \x01 so that we match the entire string, not by line.
-  replace(result.begin(), result.end(), '\n', '\x01');
-  // Strip the propagation of saliency threshold.
-  // "[\\s\\x01]+" is whitespace "[\\d\\.]+" is a float value.
-  // TODO: The original source may have comments, so need to strip these.
-  result = regex_replace(result, regex("[\\s\\x01]+[\\d\\.]+[\\s\\x01]*\\)$"), ")");
-  // Restore \n.
-  replace(result.begin(), result.end(), '\x01', '\n');
-  return result;
+  return replicodeObjects.getHtmlFragmentCache().get(mkRdx, HtmlFragmentCache::MK_RDX_HTML, [&]() {
+    return htmlifyWithLinks(
+      mkRdx, SourceFormatter::simplifyMkRdxSource(replicodeObjects.getSourceCode(mkRdx)).c_str(), replicodeObjects);
+  });
 }
 
 QString ProgramReductionItem::makeHtml()
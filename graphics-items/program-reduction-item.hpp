@@ -71,12 +71,13 @@ public:
     AeraVisualizerScene* parent);
 
   /**
-   * Start with the source from replicodeObjects_.getSourceCode for a mk.rdx, and
-   * strip the propagation of saliency threshold.
-   * \param mkRdxSource The source from replicodeObjects_.getSourceCode.
-   * \return The simplified source code
+   * Get the simplified source code HTML of the mk.rdx with links, using the HtmlFragmentCache
+   * of replicodeObjects so that the item and the explanation log share it.
+   * \param mkRdx The mk.rdx object.
+   * \param replicodeObjects The ReplicodeObjects for the source code and the cache.
+   * \return The HTML.
    */
-  static std::string simplifyMkRdxSource(const std::string& mkRdxSource);
+  static QString getMkRdxHtml(r_code::Code* mkRdx, const ReplicodeObjects& replicodeObjects);
 
 private:
   QString makeHtml();
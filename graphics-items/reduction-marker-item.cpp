@@ -51,11 +51,11 @@
 //_/_/ 
 //_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 
-#include <regex>
 #include <QMenu>
 #include "explanation-log-window.hpp"
 #include "../aera-visualizer-window.hpp"
 #include "aera-visualizer-scene.hpp"
+#include "source-formatter.hpp"
 #include "reduction-marker-item.hpp"
 
 using namespace std;
@@ -77,14 +77,12 @@ ReductionMarkerItem::ReductionMarkerItem(
 void ReductionMarkerItem::setMkRdxHtml()
 {
   // Strip the ending propagation of saliency threshold.
-  regex saliencyRegex("\\s+[\\w\\:]+\\)$");
-  string mkRdxSource = regex_replace(
-    replicodeObjects_.getSourceCode(newReductionMarkerEvent_->object_), saliencyRegex, ")");
+  string mkRdxSource = SourceFormatter::stripSaliency(
+    replicodeObjects_.getSourceCode(newReductionMarkerEvent_->object_));
 
   mkRdxHtml_ = QString(mkRdxSource.c_str());
 
-  addSourceCodeHtmlLinks(newReductionMarkerEvent_->object_, mkRdxHtml_);
-  mkRdxHtml_ = htmlify(mkRdxHtml_);
+  mkRdxHtml_ = htmlifyWithLinks(newReductionMarkerEvent_->object_, mkRdxHtml_);
 }
 
 }
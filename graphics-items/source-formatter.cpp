@@ -0,0 +1,349 @@
+//_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+//_/_/
+//_/_/ AERA Visualizer
+//_/_/ 
+//_/_/ Copyright (c) 2018-2025 Jeff Thompson
+//_/_/ Copyright (c) 2018-2025 Kristinn R. Thorisson
+//_/_/ Copyright (c) 2018-2025 Icelandic Institute for Intelligent Machines
+//_/_/ http://www.iiim.is
+//_/_/
+//_/_/ --- Open-Source BSD License, with CADIA Clause v 1.0 ---
+//_/_/
+//_/_/ Redistribution and use in source and binary forms, with or without
+//_/_/ modification, is permitted provided that the following conditions
+//_/_/ are met:
+//_/_/ - Redistributions of source code must retain the above copyright
+//_/_/   and collaboration notice, this list of conditions and the
+//_/_/   following disclaimer.
+//_/_/ - Redistributions in binary form must reproduce the above copyright
+//_/_/   notice, this list of conditions and the following disclaimer 
+//_/_/   in the documentation and/or other materials provided with 
+//_/_/   the distribution.
+//_/_/
+//_/_/ - Neither the name of its copyright holders nor the names of its
+//_/_/   contributors may be used to endorse or promote products
+//_/_/   derived from this software without specific prior 
+//_/_/   written permission.
+//_/_/   
+//_/_/ - CADIA Clause: The license granted in and to the software 
+//_/_/   under this agreement is a limited-use license. 
+//_/_/   The software may not be used in furtherance of:
+//_/_/    (i)   intentionally causing bodily injury or severe emotional 
+//_/_/          distress to any person;
+//_/_/    (ii)  invading the personal privacy or violating the human 
+//_/_/          rights of any person; or
+//_/_/    (iii) committing or preparing for any act of war.
+//_/_/
+//_/_/ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND 
+//_/_/ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+//_/_/ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+//_/_/ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+//_/_/ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR 
+//_/_/ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+//_/_/ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+//_/_/ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+//_/_/ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//_/_/ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+//_/_/ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+//_/_/ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+//_/_/ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY 
+//_/_/ OF SUCH DAMAGE.
+//_/_/ 
+//_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+
+#include <QRegularExpression>
+#include "source-formatter.hpp"
+
+using namespace std;
+
+namespace aera_visualizer {
+
+// These match the character classes \w and \s of the original regular expressions.
+static bool isWordChar(char c)
+{
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static bool isSpaceChar(char c)
+{
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static bool isFloatChar(char c) { return (c >= '0' && c <= '9') || c == '.'; }
+
+static bool isBracketedValueChar(char c)
+{
+  return isWordChar(c) || isSpaceChar(c) || c == '.' || c == ':' || c == '-';
+}
+
+size_t SourceFormatter::findSaliencyStart(const string& source, int confidenceLength)
+{
+  // Scan backwards from the ending ")".
+  size_t pos = source.size();
+  if (pos == 0 || source[pos - 1] != ')')
+    return string::npos;
+  --pos;
+
+  // The saliency may be a wildcard ":".
+  size_t end = pos;
+  while (pos > 0 && (isWordChar(source[pos - 1]) || source[pos - 1] == ':'))
+    --pos;
+  if (pos == end)
+    return string::npos;
+  end = pos;
+  while (pos > 0 && isSpaceChar(source[pos - 1]))
+    --pos;
+  if (pos == end)
+    return string::npos;
+
+  if (confidenceLength < 0)
+    return pos;
+
+  if (confidenceLength == 0) {
+    end = pos;
+    while (pos > 0 && isWordChar(source[pos - 1]))
+      --pos;
+    if (pos == end)
+      return string::npos;
+  }
+  else {
+    if (pos == 0 || !(isWordChar(source[pos - 1]) || source[pos - 1] == ':'))
+      return string::npos;
+    --pos;
+  }
+  end = pos;
+  while (pos > 0 && isSpaceChar(source[pos - 1]))
+    --pos;
+  if (pos == end)
+    return string::npos;
+
+  return pos;
+}
+
+size_t SourceFormatter::findParametersStart(const string& source, bool hasGroups, int nParameters)
+{
+  // Scan backwards from the ending ")".
+  size_t pos = source.size();
+  if (pos == 0 || source[pos - 1] != ')')
+    return string::npos;
+  --pos;
+  while (pos > 0 && isSpaceChar(source[pos - 1]))
+    --pos;
+
+  for (int i = 0; i < nParameters; ++i) {
+    size_t end = pos;
+    while (pos > 0 && isFloatChar(source[pos - 1]))
+      --pos;
+    if (pos == end)
+      return string::npos;
+    end = pos;
+    while (pos > 0 && isSpaceChar(source[pos - 1]))
+      --pos;
+    if (pos == end)
+      return string::npos;
+  }
+
+  if (hasGroups) {
+    if (pos == 0 || source[pos - 1] != ']')
+      return string::npos;
+    --pos;
+    size_t end = pos;
+    while (pos > 0 && (isWordChar(source[pos - 1]) || isSpaceChar(source[pos - 1])))
+      --pos;
+    if (pos == end || pos == 0 || source[pos - 1] != '[')
+      return string::npos;
+    --pos;
+    end = pos;
+    while (pos > 0 && isSpaceChar(source[pos - 1]))
+      --pos;
+    if (pos == end)
+      return string::npos;
+  }
+
+  return pos;
+}
+
+string SourceFormatter::stripSaliency(const string& source)
+{
+  size_t start = findSaliencyStart(source, -1);
+  return (start == string::npos ? source : source.substr(0, start) + ")");
+}
+
+string SourceFormatter::stripConfidenceAndSaliency(const string& source)
+{
+  size_t start = findSaliencyStart(source, 0);
+  return (start == string::npos ? source : source.substr(0, start) + ")");
+}
+
+string SourceFormatter::stripShortConfidenceAndSaliency(const string& source)
+{
+  size_t start = findSaliencyStart(source, 1);
+  return (start == string::npos ? source : source.substr(0, start) + ")");
+}
+
+QString SourceFormatter::simplifyModelSource(const string& modelSource)
+{
+  string result = modelSource;
+  // Strip the set of output groups and parameters.
+  // TODO: The original source may have comments, so need to strip these.
+  size_t start = findParametersStart(result, true, 5);
+  if (start != string::npos)
+    result = result.substr(0, start) + ")";
+
+  // TODO: Correctly remove wildcards.
+  replaceAll(result, " : :)", ")");
+  replaceAll(result, " :)", ")");
+
+  return result.c_str();
+}
+
+string SourceFormatter::simplifyCstSource(const string& cstSource)
+{
+  string result = cstSource;
+  // Strip the set of output groups and parameters.
+  // TODO: The original source may have comments, so need to strip these.
+  size_t start = findParametersStart(result, true, 1);
+  if (start != string::npos)
+    result = result.substr(0, start) + ")";
+
+  // TODO: Correctly remove wildcards.
+  replaceAll(result, " : :)", ")");
+  replaceAll(result, " :)", ")");
+
+  return result;
+}
+
+string SourceFormatter::simplifyMkRdxSource(const string& mkRdxSource)
+{
+  // Strip the propagation of saliency threshold.
+  // TODO: The original source may have comments, so need to strip these.
+  size_t start = findParametersStart(mkRdxSource, false, 1);
+  return (start == string::npos ? mkRdxSource : mkRdxSource.substr(0, start) + ")");
+}
+
+bool SourceFormatter::findImdlTemplateValues(const string& imdlSource, size_t& start, size_t& length)
+{
+  if (imdlSource.compare(0, 6, "(imdl ") != 0)
+    return false;
+
+  // Skip the model label.
+  size_t pos = 6;
+  while (pos < imdlSource.size() && isWordChar(imdlSource[pos]))
+    ++pos;
+  if (pos == 6 || imdlSource.compare(pos, 2, " [") != 0)
+    return false;
+  ++pos;
+
+  size_t close = imdlSource.find(']', pos + 1);
+  if (close == string::npos || close == pos + 1)
+    return false;
+  // Expect more source code after the template values.
+  if (close + 2 >= imdlSource.size() || imdlSource[close + 1] != ' ' || imdlSource[close + 2] == '\n')
+    return false;
+
+  start = pos;
+  length = close + 1 - pos;
+  return true;
+}
+
+string SourceFormatter::getSecondBracketedValues(const string& source)
+{
+  // Return the index after the closing ']', or string::npos.
+  auto scanBracketedValues = [&](size_t pos) {
+    if (pos >= source.size() || source[pos] != '[')
+      return string::npos;
+    ++pos;
+    while (pos < source.size() && isBracketedValueChar(source[pos]))
+      ++pos;
+    return (pos < source.size() && source[pos] == ']' ? pos + 1 : string::npos);
+  };
+
+  for (size_t first = source.find('['); first != string::npos; first = source.find('[', first + 1)) {
+    size_t firstEnd = scanBracketedValues(first);
+    if (firstEnd == string::npos || firstEnd >= source.size() || source[firstEnd] != ' ')
+      continue;
+
+    size_t secondEnd = scanBracketedValues(firstEnd + 1);
+    if (secondEnd != string::npos)
+      return source.substr(firstEnd + 1, secondEnd - (firstEnd + 1));
+  }
+
+  return "";
+}
+
+string SourceFormatter::getCstMembersSource(const string& cstSource)
+{
+  size_t firstLineEnd = cstSource.find('\n');
+  if (firstLineEnd == string::npos || firstLineEnd == 0)
+    return "";
+
+  size_t start = firstLineEnd + 1;
+  size_t pos = start;
+  while (cstSource.compare(pos, 3, "   ") == 0) {
+    size_t lineEnd = cstSource.find('\n', pos + 3);
+    if (lineEnd == string::npos || lineEnd == pos + 3)
+      // Each member line must be non-empty and end with \n .
+      break;
+    pos = lineEnd + 1;
+  }
+
+  if (pos == start)
+    return "";
+  // Strip the ending \n .
+  return cstSource.substr(start, pos - 1 - start);
+}
+
+void SourceFormatter::clearBackwardGuards(string& modelSource)
+{
+  for (size_t i = modelSource.find("\n[]"); i != string::npos; i = modelSource.find("\n[]", i + 1)) {
+    // Check that the rest of the source is only lines indented by three spaces.
+    size_t pos = i + 3;
+    int nGuards = 0;
+    while (modelSource.compare(pos, 4, "\n   ") == 0) {
+      size_t lineEnd = min(modelSource.find('\n', pos + 4), modelSource.size());
+      if (lineEnd == pos + 4)
+        break;
+      pos = lineEnd;
+      ++nGuards;
+    }
+
+    if (nGuards > 0 && pos == modelSource.size()) {
+      modelSource.replace(i, string::npos, "\n|[])");
+      return;
+    }
+  }
+}
+
+void SourceFormatter::replaceAll(string& str, const string& find, const string& replace)
+{
+  if (find.empty())
+    return;
+
+  for (size_t pos = str.find(find); pos != string::npos; pos = str.find(find, pos + replace.size()))
+    str.replace(pos, find.size(), replace);
+}
+
+void SourceFormatter::highlightLhsAndRhs(QString& html)
+{
+  // Assume the LHS and RHS are the second and third lines, indented by three spaces.
+  static const QRegularExpression lhsAndRhsRegex("^(.+\\n   )(.+)(\\n   )(.+)");
+  auto match = lhsAndRhsRegex.match(html);
+  if (match.hasMatch()) {
+    // match.captured(1) is the first line and indentation of the second line.
+    // match.captured(3) is the indentation of the third line.
+    QString lhs = "<font style=\"background-color:#ffe8e8\">" + match.captured(2) + "</font>";
+    QString rhs = "<font style=\"background-color:#e0ffe0\">" + match.captured(4) + "</font>";
+
+    html = match.captured(1) + lhs + match.captured(3) + rhs + html.mid(match.captured(0).size());
+  }
+}
+
+void SourceFormatter::highlightVariables(QString& html)
+{
+  // This won't match if a variable is at the beginning of a string, but we don't expect that.
+  // Debug: We also want (\\W) at the end of the regex, but then the match would overlap in "v1 v2".
+  static const QRegularExpression variableRegex("(\\W)(v\\d+\\:?)");
+  html.replace(variableRegex, "\\1<font color=\"#c000c0\">\\2</font>");
+}
+
+}
@@ -0,0 +1,198 @@
+//_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+//_/_/
+//_/_/ AERA Visualizer
+//_/_/ 
+//_/_/ Copyright (c) 2018-2025 Jeff Thompson
+//_/_/ Copyright (c) 2018-2025 Kristinn R. Thorisson
+//_/_/ Copyright (c) 2018-2025 Icelandic Institute for Intelligent Machines
+//_/_/ http://www.iiim.is
+//_/_/
+//_/_/ --- Open-Source BSD License, with CADIA Clause v 1.0 ---
+//_/_/
+//_/_/ Redistribution and use in source and binary forms, with or without
+//_/_/ modification, is permitted provided that the following conditions
+//_/_/ are met:
+//_/_/ - Redistributions of source code must retain the above copyright
+//_/_/   and collaboration notice, this list of conditions and the
+//_/_/   following disclaimer.
+//_/_/ - Redistributions in binary form must reproduce the above copyright
+//_/_/   notice, this list of conditions and the following disclaimer 
+//_/_/   in the documentation and/or other materials provided with 
+//_/_/   the distribution.
+//_/_/
+//_/_/ - Neither the name of its copyright holders nor the names of its
+//_/_/   contributors may be used to endorse or promote products
+//_/_/   derived from this software without specific prior 
+//_/_/   written permission.
+//_/_/   
+//_/_/ - CADIA Clause: The license granted in and to the software 
+//_/_/   under this agreement is a limited-use license. 
+//_/_/   The software may not be used in furtherance of:
+//_/_/    (i)   intentionally causing bodily injury or severe emotional 
+//_/_/          distress to any person;
+//_/_/    (ii)  invading the personal privacy or violating the human 
+//_/_/          rights of any person; or
+//_/_/    (iii) committing or preparing for any act of war.
+//_/_/
+//_/_/ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND 
+//_/_/ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+//_/_/ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+//_/_/ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+//_/_/ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR 
+//_/_/ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+//_/_/ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+//_/_/ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+//_/_/ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//_/_/ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+//_/_/ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+//_/_/ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+//_/_/ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY 
+//_/_/ OF SUCH DAMAGE.
+//_/_/ 
+//_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+
+#ifndef SOURCE_FORMATTER_HPP
+#define SOURCE_FORMATTER_HPP
+
+#include <string>
+#include <QString>
+
+namespace aera_visualizer {
+
+/**
+ * SourceFormatter has static methods to simplify and highlight the Replicode source code
+ * which the graphics items display. These are called for every new item, so instead of
+ * compiling a regular expression on each call, the simple patterns use hand-written
+ * scanners and the rest use regular expressions which are compiled once.
+ */
+class SourceFormatter
+{
+public:
+  /**
+   * Strip the ending propagation of saliency threshold, as in "(mk.val ... 1)" to "(mk.val ...)".
+   * \param source The source from replicodeObjects_.getSourceCode.
+   * \return The source without the ending saliency, or the unchanged source if it doesn't end
+   * with a saliency.
+   */
+  static std::string stripSaliency(const std::string& source);
+
+  /**
+   * Strip the ending confidence value and propagation of saliency threshold, as in
+   * "(fact ... 1 1)" to "(fact ...)".
+   * \param source The source from replicodeObjects_.getSourceCode.
+   * \return The source without the ending confidence and saliency, or the unchanged source if it
+   * doesn't end with them.
+   */
+  static std::string stripConfidenceAndSaliency(const std::string& source);
+
+  /**
+   * Like stripConfidenceAndSaliency, but the confidence is a single character which can be a
+   * wildcard, as in "(imdl ... : :)" to "(imdl ...)".
+   * \param source The source from replicodeObjects_.getSourceCode.
+   * \return The source without the ending confidence and saliency, or the unchanged source if it
+   * doesn't end with them.
+   */
+  static std::string stripShortConfidenceAndSaliency(const std::string& source);
+
+  /**
+   * Start with the source from replicodeObjects_.getSourceCode for a model, and
+   * remove the set of output groups and parameters, and remove trailing wildcards.
+   * \param modelSource The source from replicodeObjects_.getSourceCode.
+   * \return The simplified source code
+   */
+  static QString simplifyModelSource(const std::string& modelSource);
+
+  /**
+   * Start with the source from replicodeObjects_.getSourceCode for a cst, and
+   * remove the set of output groups and parameters, and remove trailing wildcards.
+   * \param cstSource The source from replicodeObjects_.getSourceCode.
+   * \return The simplified source code
+   */
+  static std::string simplifyCstSource(const std::string& cstSource);
+
+  /**
+   * Start with the source from replicodeObjects_.getSourceCode for a mk.rdx, and
+   * strip the propagation of saliency threshold.
+   * \param mkRdxSource The source from replicodeObjects_.getSourceCode.
+   * \return The simplified source code
+   */
+  static std::string simplifyMkRdxSource(const std::string& mkRdxSource);
+
+  /**
+   * Find the set of template values in imdl source code of the form "(imdl mdl_74 [...] ...)".
+   * \param imdlSource The imdl source code.
+   * \param start Set this to the index of the opening '['. If this returns false, this is undetermined.
+   * \param length Set this to the length of the template values including the brackets. If this
+   * returns false, this is undetermined.
+   * \return True if found the template values.
+   */
+  static bool findImdlTemplateValues(const std::string& imdlSource, size_t& start, size_t& length);
+
+  /**
+   * Find the first two consecutive sets of bracketed values and return the second, as in
+   * "[b v4: v5: v6: v7:]" from "(imdl mdl_74 [10 0s:300ms:0us 0s:400ms:0us] [b v4: v5: v6: v7:] : :)".
+   * \param source The source code.
+   * \return The second set of bracketed values including the brackets, or "" if not found.
+   */
+  static std::string getSecondBracketedValues(const std::string& source);
+
+  /**
+   * Get the set of cst members, which start on the second line and are indented by three spaces.
+   * \param cstSource The cst source from simplifyCstSource.
+   * \return The member lines without the ending \n, or "" if not found.
+   */
+  static std::string getCstMembersSource(const std::string& cstSource);
+
+  /**
+   * Replace the backward guards at the end of the model source with an empty set. The backward
+   * guards are the last line "[]" followed by the lines of guards indented by three spaces.
+   * \param modelSource The model source code with \n line endings. This is modified in place.
+   */
+  static void clearBackwardGuards(std::string& modelSource);
+
+  /**
+   * Replace every occurrence of the literal string find with replace.
+   * \param str The string to modify.
+   * \param find The literal string to find.
+   * \param replace The replacement string.
+   */
+  static void replaceAll(std::string& str, const std::string& find, const std::string& replace);
+
+  /**
+   * Assume the html is a model with \n line endings, and highlight the left-hand-side
+   * and right-hand-side expressions with red and green background.
+   * \param html The model HTML string to modify.
+   */
+  static void highlightLhsAndRhs(QString& html);
+
+  /**
+   * Modify the HTML string to change the font color of variables.
+   * \param html The HTML string to modify.
+   */
+  static void highlightVariables(QString& html);
+
+private:
+  /**
+   * If source ends with the propagation of saliency threshold, optionally preceded by a confidence
+   * value, then get the index of the whitespace before them.
+   * \param source The source code.
+   * \param confidenceLength If -1, there is no confidence value. If 0, the confidence value is
+   * one or more word characters. If 1, the confidence value is one word character or a wildcard.
+   * \return The index of the whitespace, or std::string::npos if source doesn't end with these.
+   */
+  static size_t findSaliencyStart(const std::string& source, int confidenceLength);
+
+  /**
+   * If source ends with an optional set of output groups followed by float parameters and ")",
+   * then get the index of the whitespace before them.
+   * \param source The source code.
+   * \param hasGroups True if the parameters are preceded by a set of groups like "[stdin]".
+   * \param nParameters The number of float parameters.
+   * \return The index of the whitespace, or std::string::npos if source doesn't end with these.
+   */
+  static size_t findParametersStart(const std::string& source, bool hasGroups, int nParameters);
+};
+
+}
+
+#endif
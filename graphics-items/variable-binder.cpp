@@ -0,0 +1,142 @@
+//_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+//_/_/
+//_/_/ AERA Visualizer
+//_/_/ 
+//_/_/ Copyright (c) 2018-2025 Jeff Thompson
+//_/_/ Copyright (c) 2018-2025 Kristinn R. Thorisson
+//_/_/ Copyright (c) 2018-2025 Icelandic Institute for Intelligent Machines
+//_/_/ http://www.iiim.is
+//_/_/
+//_/_/ --- Open-Source BSD License, with CADIA Clause v 1.0 ---
+//_/_/
+//_/_/ Redistribution and use in source and binary forms, with or without
+//_/_/ modification, is permitted provided that the following conditions
+//_/_/ are met:
+//_/_/ - Redistributions of source code must retain the above copyright
+//_/_/   and collaboration notice, this list of conditions and the
+//_/_/   following disclaimer.
+//_/_/ - Redistributions in binary form must reproduce the above copyright
+//_/_/   notice, this list of conditions and the following disclaimer 
+//_/_/   in the documentation and/or other materials provided with 
+//_/_/   the distribution.
+//_/_/
+//_/_/ - Neither the name of its copyright holders nor the names of its
+//_/_/   contributors may be used to endorse or promote products
+//_/_/   derived from this software without specific prior 
+//_/_/   written permission.
+//_/_/   
+//_/_/ - CADIA Clause: The license granted in and to the software 
+//_/_/   under this agreement is a limited-use license. 
+//_/_/   The software may not be used in furtherance of:
+//_/_/    (i)   intentionally causing bodily injury or severe emotional 
+//_/_/          distress to any person;
+//_/_/    (ii)  invading the personal privacy or violating the human 
+//_/_/          rights of any person; or
+//_/_/    (iii) committing or preparing for any act of war.
+//_/_/
+//_/_/ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND 
+//_/_/ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+//_/_/ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+//_/_/ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+//_/_/ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR 
+//_/_/ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+//_/_/ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+//_/_/ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+//_/_/ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//_/_/ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+//_/_/ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+//_/_/ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+//_/_/ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY 
+//_/_/ OF SUCH DAMAGE.
+//_/_/ 
+//_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+
+#include "variable-binder.hpp"
+
+using namespace std;
+
+namespace aera_visualizer {
+
+VariableBinder::VariableBinder(
+  const QStringList& templateValues, const QStringList& exposedValues,
+  int iAfterVariable, int iBeforeVariable)
+{
+  int iVariable = -1;
+  // v0, v1, v2, etc. are split between templateValues and exposedValues.
+  for (int i = 0; i < templateValues.size() + exposedValues.size(); ++i) {
+    ++iVariable;
+    if (iVariable == iAfterVariable)
+      ++iVariable;
+    if (iVariable == iBeforeVariable)
+      ++iVariable;
+
+    setValue(iVariable, (i < templateValues.size() ?
+      templateValues[i] : exposedValues[i - templateValues.size()]).toStdString(), false);
+  }
+}
+
+void VariableBinder::setReplacement(int iVariable, const string& value)
+{
+  setValue(iVariable, value, true);
+}
+
+void VariableBinder::setValue(int iVariable, const string& value, bool isReplacement)
+{
+  if (iVariable < 0)
+    return;
+
+  if ((size_t)iVariable >= values_.size()) {
+    values_.resize(iVariable + 1);
+    isBound_.resize(iVariable + 1, false);
+    isReplacement_.resize(iVariable + 1, false);
+  }
+
+  values_[iVariable] = value;
+  isBound_[iVariable] = true;
+  isReplacement_[iVariable] = isReplacement;
+}
+
+string VariableBinder::bind(const string& source, bool keepVariables, bool skipAssignments) const
+{
+  string result;
+  result.reserve(source.size() * 2);
+
+  size_t copyStart = 0;
+  size_t pos = 0;
+  while ((pos = source.find('v', pos)) != string::npos) {
+    // Check for a token vN: where N has no leading zero.
+    size_t digitsStart = pos + 1;
+    size_t digitsEnd = digitsStart;
+    while (digitsEnd < source.size() && source[digitsEnd] >= '0' && source[digitsEnd] <= '9')
+      ++digitsEnd;
+    if (digitsEnd == digitsStart || digitsEnd >= source.size() || source[digitsEnd] != ':' ||
+        (source[digitsStart] == '0' && digitsEnd - digitsStart > 1) ||
+        (skipAssignments && pos >= 4 && source.compare(pos - 4, 4, "\n   ") == 0)) {
+      ++pos;
+      continue;
+    }
+
+    size_t iVariable = 0;
+    for (size_t i = digitsStart; i < digitsEnd; ++i) {
+      iVariable = iVariable * 10 + (source[i] - '0');
+      if (iVariable >= values_.size())
+        break;
+    }
+    if (iVariable >= values_.size() || !isBound_[iVariable]) {
+      pos = digitsEnd + 1;
+      continue;
+    }
+
+    // Include the variable "vN:" if keeping it.
+    bool keepVariable = (keepVariables && !isReplacement_[iVariable]);
+    result.append(source, copyStart, (keepVariable ? digitsEnd + 1 : pos) - copyStart);
+    result += values_[iVariable];
+    pos = digitsEnd + 1;
+    copyStart = pos;
+  }
+
+  result.append(source, copyStart, string::npos);
+  return result;
+}
+
+}
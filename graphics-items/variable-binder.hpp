@@ -0,0 +1,114 @@
+//_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+//_/_/
+//_/_/ AERA Visualizer
+//_/_/ 
+//_/_/ Copyright (c) 2018-2025 Jeff Thompson
+//_/_/ Copyright (c) 2018-2025 Kristinn R. Thorisson
+//_/_/ Copyright (c) 2018-2025 Icelandic Institute for Intelligent Machines
+//_/_/ http://www.iiim.is
+//_/_/
+//_/_/ --- Open-Source BSD License, with CADIA Clause v 1.0 ---
+//_/_/
+//_/_/ Redistribution and use in source and binary forms, with or without
+//_/_/ modification, is permitted provided that the following conditions
+//_/_/ are met:
+//_/_/ - Redistributions of source code must retain the above copyright
+//_/_/   and collaboration notice, this list of conditions and the
+//_/_/   following disclaimer.
+//_/_/ - Redistributions in binary form must reproduce the above copyright
+//_/_/   notice, this list of conditions and the following disclaimer 
+//_/_/   in the documentation and/or other materials provided with 
+//_/_/   the distribution.
+//_/_/
+//_/_/ - Neither the name of its copyright holders nor the names of its
+//_/_/   contributors may be used to endorse or promote products
+//_/_/   derived from this software without specific prior 
+//_/_/   written permission.
+//_/_/   
+//_/_/ - CADIA Clause: The license granted in and to the software 
+//_/_/   under this agreement is a limited-use license. 
+//_/_/   The software may not be used in furtherance of:
+//_/_/    (i)   intentionally causing bodily injury or severe emotional 
+//_/_/          distress to any person;
+//_/_/    (ii)  invading the personal privacy or violating the human 
+//_/_/          rights of any person; or
+//_/_/    (iii) committing or preparing for any act of war.
+//_/_/
+//_/_/ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND 
+//_/_/ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+//_/_/ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+//_/_/ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+//_/_/ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR 
+//_/_/ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+//_/_/ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+//_/_/ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+//_/_/ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//_/_/ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+//_/_/ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+//_/_/ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+//_/_/ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY 
+//_/_/ OF SUCH DAMAGE.
+//_/_/ 
+//_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+
+#ifndef VARIABLE_BINDER_HPP
+#define VARIABLE_BINDER_HPP
+
+#include <string>
+#include <vector>
+#include <QStringList>
+
+namespace aera_visualizer {
+
+/**
+ * VariableBinder holds the values of the variables v0, v1, v2, etc. from an icst or imdl
+ * and substitutes them in the source code of the cst or model. Instead of a regex_replace
+ * for each variable, bind() walks the source once and recognizes each vN: token.
+ */
+class VariableBinder
+{
+public:
+  /**
+   * Create a VariableBinder where v0, v1, v2, etc. are bound in order to the templateValues
+   * followed by the exposedValues, skipping the timing variables.
+   * \param templateValues The template values from getIcstOrImdlValues.
+   * \param exposedValues The exposed values from getIcstOrImdlValues.
+   * \param iAfterVariable The index of the after variable from ModelItem::getTimingVariables.
+   * \param iBeforeVariable The index of the before variable from ModelItem::getTimingVariables.
+   */
+  VariableBinder(
+    const QStringList& templateValues, const QStringList& exposedValues,
+    int iAfterVariable, int iBeforeVariable);
+
+  /**
+   * Set the value of the variable so that bind() replaces the variable with the value, even
+   * if keepVariables is true. This is used for the timing variables.
+   * \param iVariable The variable index, as in 1 for v1.
+   * \param value The value to replace the variable.
+   */
+  void setReplacement(int iVariable, const std::string& value);
+
+  /**
+   * Return a copy of the source where each bound variable token vN: is substituted.
+   * A variable without a value is unchanged.
+   * \param source The source code.
+   * \param keepVariables If true, keep the variable before its value as in "v1:5", except
+   * for a value from setReplacement. If false, replace the variable with the value.
+   * \param skipAssignments If true, don't substitute a variable at the start of a line
+   * indented by three spaces, which is an assignment in a model.
+   * \return The bound source code.
+   */
+  std::string bind(const std::string& source, bool keepVariables, bool skipAssignments = false) const;
+
+private:
+  void setValue(int iVariable, const std::string& value, bool isReplacement);
+
+  std::vector<std::string> values_;
+  // isBound_[i] is true if values_[i] is set.
+  std::vector<bool> isBound_;
+  std::vector<bool> isReplacement_;
+};
+
+}
+
+#endif
@@ -0,0 +1,143 @@
+//_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+//_/_/
+//_/_/ AERA Visualizer
+//_/_/ 
+//_/_/ Copyright (c) 2018-2025 Jeff Thompson
+//_/_/ Copyright (c) 2018-2025 Kristinn R. Thorisson
+//_/_/ Copyright (c) 2018-2025 Icelandic Institute for Intelligent Machines
+//_/_/ http://www.iiim.is
+//_/_/
+//_/_/ --- Open-Source BSD License, with CADIA Clause v 1.0 ---
+//_/_/
+//_/_/ Redistribution and use in source and binary forms, with or without
+//_/_/ modification, is permitted provided that the following conditions
+//_/_/ are met:
+//_/_/ - Redistributions of source code must retain the above copyright
+//_/_/   and collaboration notice, this list of conditions and the
+//_/_/   following disclaimer.
+//_/_/ - Redistributions in binary form must reproduce the above copyright
+//_/_/   notice, this list of conditions and the following disclaimer 
+//_/_/   in the documentation and/or other materials provided with 
+//_/_/   the distribution.
+//_/_/
+//_/_/ - Neither the name of its copyright holders nor the names of its
+//_/_/   contributors may be used to endorse or promote products
+//_/_/   derived from this software without specific prior 
+//_/_/   written permission.
+//_/_/   
+//_/_/ - CADIA Clause: The license granted in and to the software 
+//_/_/   under this agreement is a limited-use license. 
+//_/_/   The software may not be used in furtherance of:
+//_/_/    (i)   intentionally causing bodily injury or severe emotional 
+//_/_/          distress to any person;
+//_/_/    (ii)  invading the personal privacy or violating the human 
+//_/_/          rights of any person; or
+//_/_/    (iii) committing or preparing for any act of war.
+//_/_/
+//_/_/ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND 
+//_/_/ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+//_/_/ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+//_/_/ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+//_/_/ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR 
+//_/_/ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+//_/_/ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+//_/_/ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+//_/_/ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//_/_/ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+//_/_/ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+//_/_/ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+//_/_/ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY 
+//_/_/ OF SUCH DAMAGE.
+//_/_/ 
+//_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+
+#ifndef HTML_FRAGMENT_CACHE_HPP
+#define HTML_FRAGMENT_CACHE_HPP
+
+#include <list>
+#include <map>
+#include <functional>
+#include <QString>
+#include "submodules/AERA/r_code/object.h"
+
+namespace aera_visualizer {
+
+/**
+ * HtmlFragmentCache holds the formatted source code of objects which many graphics items show,
+ * such as the simplified source of a model which is shown by the model item and by each
+ * prediction from it. A fragment is keyed by the object and the formatting variant. The items keep a copy of the
+ * QString, which shares the cached data. When the fragments exceed the memory limit, the least
+ * recently used are removed. The objects are kept by ReplicodeObjects for the whole session, so a
+ * fragment stays valid until clear().
+ */
+class HtmlFragmentCache {
+public:
+  typedef enum {
+    // The simplified model source with links and highlighted LHS, RHS and variables, as shown by ModelItem.
+    MODEL_HTML,
+    // The simplified model source (not HTML) with highlighted LHS and RHS, for binding the variables.
+    LHS_RHS_MODEL_SOURCE,
+    // LHS_RHS_MODEL_SOURCE as HTML with links and highlighted variables, as shown by PredictionItem.
+    UNBOUND_MODEL_HTML,
+    // The simplified cst source with links and highlighted variables, as shown by CompositeStateItem.
+    CST_HTML,
+    // The simplified mk.rdx source with links, as shown by ProgramReductionItem and the explanation log.
+    MK_RDX_HTML
+  } Variant;
+
+  /**
+   * Create an HtmlFragmentCache.
+   * \param maxBytes (optional) The limit of the total size of the fragments. If omitted, use DefaultMaxBytes.
+   */
+  HtmlFragmentCache(size_t maxBytes = DefaultMaxBytes);
+
+  /**
+   * Get the HTML fragment for the object and variant. If it is not in the cache, call make() and
+   * add the result to the cache.
+   * \param object The object which is formatted.
+   * \param variant The formatting variant.
+   * \param make The function to make the fragment if it is not in the cache.
+   * \return The HTML fragment, which shares its data with the cache.
+   */
+  QString get(r_code::Code* object, Variant variant, const std::function<QString()>& make);
+
+  /**
+   * Remove all fragments and reset the counters, for example when loading new objects.
+   */
+  void clear();
+
+  size_t getHitCount() const { return hitCount_; }
+  size_t getMissCount() const { return missCount_; }
+  size_t getByteCount() const { return byteCount_; }
+
+  static const size_t DefaultMaxBytes;
+
+private:
+  typedef std::pair<r_code::Code*, Variant> Key;
+
+  class Entry {
+  public:
+    QString fragment_;
+    // The position of the key in lruKeys_.
+    std::list<Key>::iterator lruPosition_;
+  };
+
+  /**
+   * Remove the least recently used fragments until byteCount_ is not more than maxBytes_.
+   */
+  void evict();
+
+  static size_t getByteCount(const QString& fragment) { return fragment.size() * sizeof(QChar); }
+
+  std::map<Key, Entry> entries_;
+  // The keys of entries_ with the most recently used first.
+  std::list<Key> lruKeys_;
+  size_t maxBytes_;
+  size_t byteCount_;
+  size_t hitCount_;
+  size_t missCount_;
+};
+
+}
+
+#endif
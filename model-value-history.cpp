@@ -0,0 +1,135 @@
+//_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+//_/_/
+//_/_/ AERA Visualizer
+//_/_/ 
+//_/_/ Copyright (c) 2018-2025 Jeff Thompson
+//_/_/ Copyright (c) 2018-2025 Kristinn R. Thorisson
+//_/_/ Copyright (c) 2018-2025 Icelandic Institute for Intelligent Machines
+//_/_/ http://www.iiim.is
+//_/_/
+//_/_/ --- Open-Source BSD License, with CADIA Clause v 1.0 ---
+//_/_/
+//_/_/ Redistribution and use in source and binary forms, with or without
+//_/_/ modification, is permitted provided that the following conditions
+//_/_/ are met:
+//_/_/ - Redistributions of source code must retain the above copyright
+//_/_/   and collaboration notice, this list of conditions and the
+//_/_/   following disclaimer.
+//_/_/ - Redistributions in binary form must reproduce the above copyright
+//_/_/   notice, this list of conditions and the following disclaimer 
+//_/_/   in the documentation and/or other materials provided with 
+//_/_/   the distribution.
+//_/_/
+//_/_/ - Neither the name of its copyright holders nor the names of its
+//_/_/   contributors may be used to endorse or promote products
+//_/_/   derived from this software without specific prior 
+//_/_/   written permission.
+//_/_/   
+//_/_/ - CADIA Clause: The license granted in and to the software 
+//_/_/   under this agreement is a limited-use license. 
+//_/_/   The software may not be used in furtherance of:
+//_/_/    (i)   intentionally causing bodily injury or severe emotional 
+//_/_/          distress to any person;
+//_/_/    (ii)  invading the personal privacy or violating the human 
+//_/_/          rights of any person; or
+//_/_/    (iii) committing or preparing for any act of war.
+//_/_/
+//_/_/ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND 
+//_/_/ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+//_/_/ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+//_/_/ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+//_/_/ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR 
+//_/_/ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+//_/_/ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+//_/_/ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+//_/_/ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//_/_/ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+//_/_/ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+//_/_/ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+//_/_/ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY 
+//_/_/ OF SUCH DAMAGE.
+//_/_/ 
+//_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+
+#include <algorithm>
+#include "submodules/AERA/r_code/replicode_defs.h"
+#include "model-value-history.hpp"
+
+using namespace std;
+using namespace core;
+using namespace r_code;
+
+namespace aera_visualizer {
+
+void ModelValueHistory::add(
+  Code* model, size_t sequence, float32 strength, float32 evidenceCount, float32 successRate)
+{
+  models_[model].insert(sequence, strength, evidenceCount, successRate);
+}
+
+void ModelValueHistory::addStrength(Code* model, size_t sequence, float32 strength)
+{
+  float32 unusedStrength, evidenceCount, successRate;
+  getLatestValues(model, sequence, unusedStrength, evidenceCount, successRate);
+  models_[model].insert(sequence, strength, evidenceCount, successRate);
+}
+
+void ModelValueHistory::addEvidenceCountAndSuccessRate(
+  Code* model, size_t sequence, float32 evidenceCount, float32 successRate)
+{
+  float32 strength, unusedEvidenceCount, unusedSuccessRate;
+  getLatestValues(model, sequence, strength, unusedEvidenceCount, unusedSuccessRate);
+  models_[model].insert(sequence, strength, evidenceCount, successRate);
+}
+
+bool ModelValueHistory::getValues(
+  Code* model, size_t sequence, float32& strength, float32& evidenceCount, float32& successRate) const
+{
+  auto columns = models_.find(model);
+  if (columns == models_.end())
+    return false;
+
+  auto& sequences = columns->second.sequences_;
+  // Find the first entry after the sequence number. The entry before it has the values.
+  size_t i = upper_bound(sequences.begin(), sequences.end(), sequence) - sequences.begin();
+  if (i == 0)
+    return false;
+  --i;
+
+  strength = columns->second.strength_[i];
+  evidenceCount = columns->second.evidenceCount_[i];
+  successRate = columns->second.successRate_[i];
+  return true;
+}
+
+void ModelValueHistory::getLatestValues(
+  Code* model, size_t sequence, float32& strength, float32& evidenceCount, float32& successRate) const
+{
+  if (getValues(model, sequence, strength, evidenceCount, successRate))
+    return;
+
+  // We don't expect this, but fall back to the values in the compiled model.
+  strength = model->code(MDL_STRENGTH).asFloat();
+  evidenceCount = model->code(MDL_CNT).asFloat();
+  successRate = model->code(MDL_SR).asFloat();
+}
+
+void ModelValueHistory::Columns::insert(
+  size_t sequence, float32 strength, float32 evidenceCount, float32 successRate)
+{
+  if (sequences_.size() == 0 || sequences_.back() <= sequence) {
+    sequences_.push_back(sequence);
+    strength_.push_back(strength);
+    evidenceCount_.push_back(evidenceCount);
+    successRate_.push_back(successRate);
+    return;
+  }
+
+  size_t i = upper_bound(sequences_.begin(), sequences_.end(), sequence) - sequences_.begin();
+  sequences_.insert(sequences_.begin() + i, sequence);
+  strength_.insert(strength_.begin() + i, strength);
+  evidenceCount_.insert(evidenceCount_.begin() + i, evidenceCount);
+  successRate_.insert(successRate_.begin() + i, successRate);
+}
+
+}
@@ -0,0 +1,150 @@
+//_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+//_/_/
+//_/_/ AERA Visualizer
+//_/_/ 
+//_/_/ Copyright (c) 2018-2025 Jeff Thompson
+//_/_/ Copyright (c) 2018-2025 Kristinn R. Thorisson
+//_/_/ Copyright (c) 2018-2025 Icelandic Institute for Intelligent Machines
+//_/_/ http://www.iiim.is
+//_/_/
+//_/_/ --- Open-Source BSD License, with CADIA Clause v 1.0 ---
+//_/_/
+//_/_/ Redistribution and use in source and binary forms, with or without
+//_/_/ modification, is permitted provided that the following conditions
+//_/_/ are met:
+//_/_/ - Redistributions of source code must retain the above copyright
+//_/_/   and collaboration notice, this list of conditions and the
+//_/_/   following disclaimer.
+//_/_/ - Redistributions in binary form must reproduce the above copyright
+//_/_/   notice, this list of conditions and the following disclaimer 
+//_/_/   in the documentation and/or other materials provided with 
+//_/_/   the distribution.
+//_/_/
+//_/_/ - Neither the name of its copyright holders nor the names of its
+//_/_/   contributors may be used to endorse or promote products
+//_/_/   derived from this software without specific prior 
+//_/_/   written permission.
+//_/_/   
+//_/_/ - CADIA Clause: The license granted in and to the software 
+//_/_/   under this agreement is a limited-use license. 
+//_/_/   The software may not be used in furtherance of:
+//_/_/    (i)   intentionally causing bodily injury or severe emotional 
+//_/_/          distress to any person;
+//_/_/    (ii)  invading the personal privacy or violating the human 
+//_/_/          rights of any person; or
+//_/_/    (iii) committing or preparing for any act of war.
+//_/_/
+//_/_/ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND 
+//_/_/ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+//_/_/ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+//_/_/ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+//_/_/ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR 
+//_/_/ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+//_/_/ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+//_/_/ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+//_/_/ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//_/_/ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+//_/_/ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+//_/_/ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+//_/_/ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY 
+//_/_/ OF SUCH DAMAGE.
+//_/_/ 
+//_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+
+#ifndef MODEL_VALUE_HISTORY_HPP
+#define MODEL_VALUE_HISTORY_HPP
+
+#include <vector>
+#include <unordered_map>
+#include "submodules/AERA/r_code/object.h"
+
+namespace aera_visualizer {
+
+/**
+ * ModelValueHistory holds the strength, evidence count and success rate of each model over
+ * time, as read from the runtime output. An entry is keyed by the sequence number of its event,
+ * not the timestamp, since several events for the same model can have the same timestamp. The
+ * startup values have sequence number 0 and the values set by events_[i] have sequence number
+ * i + 1, so the sequence number is the count of events which were stepped. The values for each
+ * model are kept in separate arrays sorted by sequence number so that getValues can find the
+ * values after any event with a binary search. The history is filled while parsing and is not
+ * changed during playback, so it is safe to query from any view in any order.
+ */
+class ModelValueHistory {
+public:
+  /**
+   * Add an entry with all the values of the model, for example when it is loaded or created.
+   * \param model The model.
+   * \param sequence The sequence number of the event which gives the model these values, or 0
+   * for the startup values.
+   * \param strength The model strength.
+   * \param evidenceCount The model evidence count.
+   * \param successRate The model success rate.
+   */
+  void add(r_code::Code* model, size_t sequence, core::float32 strength,
+    core::float32 evidenceCount, core::float32 successRate);
+
+  /**
+   * Add an entry where the strength changes and the other values are the same as in the
+   * previous entry.
+   * \param model The model.
+   * \param sequence The sequence number of the event of the change.
+   * \param strength The new strength.
+   */
+  void addStrength(r_code::Code* model, size_t sequence, core::float32 strength);
+
+  /**
+   * Add an entry where the evidence count and success rate change and the strength is the same
+   * as in the previous entry.
+   * \param model The model.
+   * \param sequence The sequence number of the event of the change.
+   * \param evidenceCount The new evidence count.
+   * \param successRate The new success rate.
+   */
+  void addEvidenceCountAndSuccessRate(
+    r_code::Code* model, size_t sequence, core::float32 evidenceCount, core::float32 successRate);
+
+  /**
+   * Get the values of the model after the events up to the sequence number were stepped.
+   * \param model The model.
+   * \param sequence The sequence number, which is the count of stepped events.
+   * \param strength Set this to the model strength.
+   * \param evidenceCount Set this to the model evidence count.
+   * \param successRate Set this to the model success rate.
+   * \return True for success, or false if there is no entry for the model at or before the
+   * sequence number, in which case the values are not changed.
+   */
+  bool getValues(r_code::Code* model, size_t sequence, core::float32& strength,
+    core::float32& evidenceCount, core::float32& successRate) const;
+
+  void clear() { models_.clear(); }
+
+private:
+  class Columns {
+  public:
+    /**
+     * Insert an entry in sequence order. An entry with the same sequence number as existing
+     * entries goes after them. Entries are added in sequence order, so this normally appends.
+     */
+    void insert(size_t sequence, core::float32 strength, core::float32 evidenceCount, core::float32 successRate);
+
+    std::vector<size_t> sequences_;
+    std::vector<core::float32> strength_;
+    std::vector<core::float32> evidenceCount_;
+    std::vector<core::float32> successRate_;
+  };
+
+  /**
+   * Get the values of the last entry for the model with a sequence number not after the given
+   * one. If there is none, use the values from the compiled model.
+   */
+  void getLatestValues(r_code::Code* model, size_t sequence, core::float32& strength,
+    core::float32& evidenceCount, core::float32& successRate) const;
+
+  // Key is the model, value is the columns of its history.
+  std::unordered_map<r_code::Code*, Columns> models_;
+};
+
+}
+
+#endif
@@ -86,6 +86,8 @@ string ReplicodeObjects::init(const string& userClassesFilePath, const string& d
     microseconds basePeriod, QProgressDialog& progress)
 {
   basePeriod_ = basePeriod;
+  // The cached fragments are for the previous objects.
+  htmlFragmentCache_.clear();
 
   // Run the proprocessor on the user operators (which includes std.replicode) just to
   // get the Metadata. The objects are repeated in the decompiled output.
@@ -192,6 +194,8 @@ string ReplicodeObjects::init(const string& userClassesFilePath, const string& d
     Code* object = imageObjects[i];
     int32 dummyLocation;
     objects_.push_back(object, dummyLocation);
+    // Like a search of objects_, keep the first object with the detail OID.
+    detailOidObject_.insert(make_pair(object->get_detail_oid(), object));
     // We don't need to delete, so don't set the storage index.
 
     switch (object->code(0).getDescriptor()) {
@@ -358,12 +362,11 @@ Code* ReplicodeObjects::getObject(uint32 oid) const
 
 Code* ReplicodeObjects::getObjectByDetailOid(uint64 detailOid) const
 {
-  for (auto o = objects_.begin(); o != objects_.end(); ++o) {
-    if ((*o)->get_detail_oid() == detailOid)
-      return *o;
-  }
+  auto entry = detailOidObject_.find(detailOid);
+  if (entry == detailOidObject_.end())
+    return NULL;
 
-  return NULL;
+  return entry->second;
 }
 
 QString ReplicodeObjects::getProgressLabelText(const QString& message)
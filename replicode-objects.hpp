@@ -59,6 +59,8 @@
 #include <regex>
 #include <QString>
 #include "submodules/AERA/r_exec/mem.h"
+#include "model-value-history.hpp"
+#include "html-fragment-cache.hpp"
 
 class QProgressDialog;
 
@@ -201,6 +203,19 @@ public:
    */
   bool getObjects(std::string oids, std::vector<r_code::Code*>& objects);
 
+  /**
+   * Get the history of model strength, evidence count and success rate, which is filled
+   * while parsing the runtime output.
+   */
+  ModelValueHistory& getModelValueHistory() { return modelValueHistory_; }
+  const ModelValueHistory& getModelValueHistory() const { return modelValueHistory_; }
+
+  /**
+   * Get the cache of formatted HTML fragments of the objects, which the graphics items share.
+   * This is not part of the state of the objects, so it can be updated through a const ReplicodeObjects.
+   */
+  HtmlFragmentCache& getHtmlFragmentCache() const { return htmlFragmentCache_; }
+
 private:
   /**
    * Process the decompiled objects file to remove OIDs, detail OIDs and info lines starting with ">".
@@ -224,8 +239,13 @@ private:
   std::map<r_code::Code*, std::string> objectLabel_;
   // Key is the label from the decompiled objects, value is the Code* object.
   std::map<std::string, r_code::Code*> labelObject_;
+  // Key is the detail OID, value is the Code* object. This is used for hovering links, so it
+  // avoids a linear search of objects_.
+  std::map<core::uint64, r_code::Code*> detailOidObject_;
   r_code::list<P<r_code::Code> > objects_;
   std::vector<QString> progressMessages_;
+  ModelValueHistory modelValueHistory_;
+  mutable HtmlFragmentCache htmlFragmentCache_;
   std::regex intMemberRegex_;
 };
 